@@ -3,28 +3,72 @@
 
 #include "consts.h"
 #include "diagnostics.h"
+#include "heap.h"
 #include "lib.h"
 #include "util.h"
+#include "workspace.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <queue>
 #include <stack>
+#include <utility>
 #include <vector>
 
 template <typename T> struct Weight {
     virtual float get(const T &from, const T &to, const T *prev = nullptr) const = 0;
 
-    float get(int from, int to, int prev, const DiGraph<T> &graph) const {
+    /**
+     * @brief Weight of an edge given by vertex indices, prev is -1 if there is none
+     * @note can be overridden by weights that are precomputed per vertex
+     */
+    virtual float get(int from, int to, int prev, const DiGraph<T> &graph) const {
         return get(graph.at(from), graph.at(to), prev < 0 ? nullptr : &graph.at(prev));
     }
 
     virtual ~Weight() = default;
 };
 
+/**
+ * @returns checksum of the edges of the graph and of their weights (without turns), files derived from them keep it to detect stale ones
+ */
+template <typename T> uint64_t fingerprint(const DiGraph<T> &graph, const Weight<T> &weight) {
+    // FNV-1a over the rows, the weights taken by their bits
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t v = 0; v < graph.size(); v++) {
+        for (int to : graph.neighbors(v)) {
+            const float w = weight.get(v, to, -1, graph);
+            uint32_t bits;
+            std::memcpy(&bits, &w, sizeof(bits));
+
+            hash = (hash ^ static_cast<uint32_t>(to)) * 0x100000001b3ULL;
+            hash = (hash ^ bits) * 0x100000001b3ULL;
+        }
+
+        hash = (hash ^ 0xffffffffULL) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
 template <typename T> struct Algorithm : Counter, virtual Sizable {
   protected:
     const DiGraph<T> &graph;
-    std::vector<int> prev;
+
+    /**
+     * @brief distances, parents and settled flags of the (forward) search, reused by every run
+     */
+    Workspace space;
+
+    /**
+     * @brief prepare for a new query: invalidate the workspace and drop the previous trace
+     */
+    void begin() {
+        space.reset();
+        trace.reset();
+    }
 
   public:
     enum class Driver {
@@ -32,90 +76,251 @@ template <typename T> struct Algorithm : Counter, virtual Sizable {
         AStar,
         BFS,
         DFS,
+        BiDijkstra,
+        BiAStar,
+        CH,
     };
 
+    /**
+     * @brief A vertex a search can start (or end) at, with the distance already covered to (or still left from) it
+     */
+    struct Seed {
+        int vertex;
+        float distance;
+    };
+
+  protected:
+    /**
+     * @returns index of the seed the search tree of v grew from, -1 if v was not reached
+     */
+    static int root(const Workspace &space, const std::vector<Seed> &seeds, int v) {
+        if (v < 0 || !space.touched(v))
+            return -1;
+
+        while (space.parent(v) >= 0)
+            v = space.parent(v);
+
+        for (size_t i = 0; i < seeds.size(); i++)
+            if (seeds[i].vertex == v)
+                return i;
+
+        return -1;
+    }
+
+  public:
+
+    /**
+     * @brief The vertices expanded by a search, and the neighbors each of them reached, for the visualization
+     * Stored as a CSR: every segment (an expanded vertex and its children) starts at an offset of a byte stream.
+     * The parent is a varint, the children are varints of their (zigzag) difference to the parent, which is
+     * usually small, as the neighbors of a vertex are numbered close to it. A segment takes 4 bytes of offset
+     * and a few bytes of parent, then about a byte per child.
+     * Recording is on by default, runs that are not drawn turn it off and pay nothing for it.
+     */
     class Trace : Sizable {
-        std::vector<int> trace;
-        unsigned int _current = 0, index = 0;
+        std::vector<uint32_t> offsets;
+        std::vector<uint8_t> bytes;
 
-      public:
-        size_t size_of() const override {
-            return true_size(trace) + sizeof(unsigned int) * 2;
-        }
+        bool recording = true;
 
         /**
-         * Marks this node as the parent of the following nodes
+         * @brief the parent of the last segment
          */
-        Trace &parent(unsigned int index) {
-            if (trace.size() > 0)
-                trace.push_back(-1);
+        int last = -1;
 
-            trace.push_back(index);
-            return *this;
+        void put(uint32_t value) {
+            while (value >= 0x80) {
+                bytes.push_back(uint8_t(value) | 0x80);
+                value >>= 7;
+            }
+
+            bytes.push_back(uint8_t(value));
         }
 
-        /**
-         * Add as children
-         */
-        Trace &child(unsigned int index) {
-            trace.push_back(index);
-            return *this;
+        static uint32_t take(const uint8_t *&at) {
+            uint32_t value = 0;
+            for (int shift = 0;; shift += 7) {
+                const uint8_t byte = *at++;
+                value |= uint32_t(byte & 0x7f) << shift;
+
+                if (byte < 0x80)
+                    return value;
+            }
         }
 
+      public:
         /**
-         * Clear the records, reset counter
+         * @brief an expanded vertex and the neighbors it reached; the children are decoded while iterated
          */
-        void reset() {
-            trace.clear();
-            _current = 0;
+        class Segment {
+            const uint8_t *first, *last;
+            int from;
+
+          public:
+            class iterator {
+                const uint8_t *at;
+                int from;
+
+              public:
+                iterator(const uint8_t *at, int from) : at(at), from(from) {}
+
+                int operator*() const {
+                    const uint8_t *it = at;
+                    const uint32_t zigzag = take(it);
+                    return from + (int)(zigzag >> 1 ^ -(zigzag & 1));
+                }
+
+                iterator &operator++() {
+                    take(at);
+                    return *this;
+                }
+
+                bool operator!=(const iterator &other) const {
+                    return at != other.at;
+                }
+            };
+
+            Segment(const uint8_t *first, const uint8_t *last) : first(first), last(last) {
+                from = take(this->first);
+            }
+
+            int parent() const {
+                return from;
+            }
+
+            iterator begin() const {
+                return iterator(first, from);
+            }
+
+            iterator end() const {
+                return iterator(last, from);
+            }
+        };
+
+        class iterator {
+            const Trace *trace;
+            size_t index;
+
+          public:
+            iterator(const Trace *trace, size_t index) : trace(trace), index(index) {}
+
+            Segment operator*() const {
+                return (*trace)[index];
+            }
+
+            iterator &operator++() {
+                index++;
+                return *this;
+            }
+
+            bool operator!=(const iterator &other) const {
+                return index != other.index;
+            }
+        };
+
+        size_t size_of() const override {
+            return true_size(offsets) + true_size(bytes);
         }
 
         /**
-         * @brief first item (parent) of the current segment
+         * @brief turn recording on or off, for the following runs
          */
-        int current() {
-            return trace[_current];
+        void record(bool on) {
+            recording = on;
+        }
+
+        bool recorded() const {
+            return recording;
         }
 
         /**
-         * @brief skip one item within this segment
+         * Marks this node as the parent of the following nodes
          */
-        int next() {
-            return trace[index++];
+        Trace &parent(int index) {
+            if (!recording)
+                return *this;
+
+            offsets.push_back(bytes.size());
+            put(index);
+
+            last = index;
+            return *this;
         }
 
         /**
-         * @brief advance to the next segment
+         * Add as children
          */
-        void skip() {
-            index++;
-            _current = index;
+        Trace &child(int index) {
+            if (!recording)
+                return *this;
+
+            const int delta = index - last;
+            put(uint32_t(delta) << 1 ^ uint32_t(delta >> 31));
+
+            return *this;
         }
 
         /**
-         * @brief checks bounds and current segment
+         * Clear the records
          */
-        bool has_next() {
-            return index < trace.size() - 1 && trace[index] >= 0;
+        void reset() {
+            offsets.clear();
+            bytes.clear();
+            last = -1;
         }
 
         /**
-         * @brief checks bounds
+         * @returns number of segments (expanded vertices)
          */
-        bool consumed() {
-            return index >= trace.size() - 4;
+        size_t size() const {
+            return offsets.size();
+        }
+
+        Segment operator[](size_t i) const {
+            const uint8_t *data = bytes.data();
+            return Segment(data + offsets[i], data + (i + 1 < offsets.size() ? offsets[i + 1] : bytes.size()));
+        }
+
+        iterator begin() const {
+            return iterator(this, 0);
+        }
+
+        iterator end() const {
+            return iterator(this, size());
         }
     };
 
   public:
     Trace trace;
 
-    Algorithm(const DiGraph<T> &graph) : graph(graph), prev(graph.size(), -1) {}
+    Algorithm(const DiGraph<T> &graph) : graph(graph), space(graph.size()) {}
 
+    /**
+     * @brief search from source to target
+     * @note can be called any number of times, every run starts from a clean state (in O(1))
+     */
     virtual void run(int source, int target, bool break_on_found = false) = 0;
 
+    /**
+     * @brief search from any of the sources to any of the targets, as if from a virtual source linked to every source by its
+     * distance, to a virtual target every target is linked to by its distance
+     * The default only runs from the first source to the first target, the drivers that weigh the edges override it.
+     * @returns index of the source and of the target the shortest route connects, -1 if there is none
+     */
+    virtual std::pair<int, int> seeded(const std::vector<Seed> &sources, const std::vector<Seed> &targets, bool break_on_found = false) {
+        run(sources.front().vertex, targets.front().vertex, break_on_found);
+        return {0, 0};
+    }
+
+    /**
+     * @brief turn the recording of the trace on or off, for the following runs (on by default)
+     */
+    virtual void record(bool on) {
+        trace.record(on);
+    }
+
     size_t size_of() const override {
-        return true_size(prev) + trace.size_of();
+        return space.size_of() + trace.size_of();
     }
 
     /**
@@ -128,12 +333,12 @@ template <typename T> struct Algorithm : Counter, virtual Sizable {
         while (u != source) {
             if (u < 0) {
                 // TODO: handle this
-                std::cout << "No route to point\n";
+                std::cerr << "No route to point\n";
                 return path;
             }
 
             path.push_back(u);
-            u = this->prev[u];
+            u = this->space.parent(u);
         }
 
         path.push_back(source);
@@ -145,31 +350,32 @@ template <typename T> struct Algorithm : Counter, virtual Sizable {
     virtual ~Algorithm() = default;
 };
 
-template <typename T> class Dijkstra : public Algorithm<T> {
-    const Weight<T> &weight;
-
-    // for storing weight and index
-    using PQitem = std::pair<float, int>;
+/**
+ * @tparam Queue priority queue of (distance, index) items, see heap.h
+ * @tparam W type of the weight; with a final class the calls are resolved at compile time and can be inlined
+ */
+template <typename T, typename Queue = LazyHeap, typename W = Weight<T>> class Dijkstra : public Algorithm<T> {
+    const W &weight;
 
-    std::vector<float> distance;
-    std::vector<bool> visited;
-    std::priority_queue<PQitem, std::vector<PQitem>, std::greater<PQitem>> pq; // max-heap
+    Queue pq;
 
   public:
-    Dijkstra(const DiGraph<T> &graph, const Weight<T> &weight)
+    Dijkstra(const DiGraph<T> &graph, const W &weight)
         : Algorithm<T>(graph), weight(weight), //
-          distance(graph.size(), FMAX), visited(graph.size(), false) {
+          pq(graph.size()) {
         this->mem(graph.size() * 2);
     }
 
     size_t size_of() const override {
-        return Algorithm<T>::size_of() + true_size(distance) + true_size(visited) //
-               + sizeof(pq) + sizeof(std::vector<PQitem>) + sizeof(PQitem) * pq.size() * 2;
+        return Algorithm<T>::size_of() + pq.size_of();
     }
 
     void run(int source, int target, bool break_on_found = false) override {
-        distance[source] = 0.f;
-        pq.emplace(0.f, source);
+        this->begin();
+        pq.clear();
+
+        this->space.set(source, 0.f, -1);
+        pq.push(0.f, source);
         bool found = false;
         this->mem(3);
 
@@ -180,27 +386,26 @@ template <typename T> class Dijkstra : public Algorithm<T> {
             this->mem(2);
 
             this->comp();
-            if (visited[current])
+            if (this->space.settled(current))
                 continue;
 
-            visited[current] = true;
+            this->space.settle(current);
             this->mem();
 
             this->trace.parent(current);
 
-            for (int neighbor : this->graph.adjacent(current)) {
+            for (int neighbor : this->graph.neighbors(current)) {
                 this->trace.child(neighbor);
                 this->step();
 
                 this->mem();
-                const float w = this->weight.get(current, neighbor, this->prev[current], this->graph);
+                const float w = this->weight.get(current, neighbor, this->space.parent(current), this->graph);
 
                 this->comp();
-                if (d + w < distance[neighbor]) {
-                    distance[neighbor] = d + w;
-                    this->prev[neighbor] = current;
+                if (d + w < this->space.distance(neighbor)) {
+                    this->space.set(neighbor, d + w, current);
 
-                    pq.emplace(d + w, neighbor);
+                    pq.push(d + w, neighbor);
                     this->mem(3);
                 }
 
@@ -212,32 +417,108 @@ template <typename T> class Dijkstra : public Algorithm<T> {
             }
         }
     }
+
+    /**
+     * @note the distance of a target is only final once it is settled, so with `break_on_found` the search goes on
+     * until no key left in the queue can improve the best target
+     */
+    std::pair<int, int> seeded(const std::vector<typename Algorithm<T>::Seed> &sources, const std::vector<typename Algorithm<T>::Seed> &targets,
+                               bool break_on_found = false) override {
+        this->begin();
+        pq.clear();
+
+        for (const auto &s : sources) {
+            this->comp();
+            if (s.distance < this->space.distance(s.vertex)) {
+                this->space.set(s.vertex, s.distance, -1);
+                pq.push(s.distance, s.vertex);
+                this->mem(3);
+            }
+        }
+
+        float best = FMAX;
+        int chosen = -1;
+
+        while (!pq.empty()) {
+            const float d = pq.top().first;
+            const int current = pq.top().second;
+            pq.pop();
+            this->mem(2);
+
+            this->comp(2);
+            if (break_on_found && d >= best)
+                break;
+
+            if (this->space.settled(current))
+                continue;
+
+            this->space.settle(current);
+            this->mem();
+
+            this->trace.parent(current);
+
+            for (size_t j = 0; j < targets.size(); j++) {
+                this->comp();
+                if (targets[j].vertex == current && d + targets[j].distance < best) {
+                    best = d + targets[j].distance;
+                    chosen = j;
+                }
+            }
+
+            for (int neighbor : this->graph.neighbors(current)) {
+                this->trace.child(neighbor);
+                this->step();
+
+                this->mem();
+                const float w = this->weight.get(current, neighbor, this->space.parent(current), this->graph);
+
+                this->comp();
+                if (d + w < this->space.distance(neighbor)) {
+                    this->space.set(neighbor, d + w, current);
+
+                    pq.push(d + w, neighbor);
+                    this->mem(3);
+                }
+            }
+        }
+
+        if (chosen < 0)
+            return {-1, -1};
+
+        return {this->root(this->space, sources, targets[chosen].vertex), chosen};
+    }
 };
 
-template <typename T> class AStar : public Algorithm<T> {
+/**
+ * @tparam Queue priority queue of (f_score, index) items, see heap.h
+ * @tparam W, H types of the weight and the heuristic, see Dijkstra
+ */
+template <typename T, typename Queue = LazyHeap, typename W = Weight<T>, typename H = Weight<T>> class AStar : public Algorithm<T> {
   private:
-    const Weight<T> &heuristic;
-    const Weight<T> &weight;
-
-    using PQitem = std::pair<float, int>; // (f_score, node)
-    std::priority_queue<PQitem, std::vector<PQitem>, std::greater<PQitem>> open_set;
+    const H &heuristic;
+    const W &weight;
 
-    std::vector<float> g_score;
+    /**
+     * @note the g scores are the distances of the workspace
+     */
+    Queue open_set;
 
   public:
-    AStar(const DiGraph<T> &graph, const Weight<T> &weight, const Weight<T> &heuristic)
+    AStar(const DiGraph<T> &graph, const W &weight, const H &heuristic)
         :                                                            //
           Algorithm<T>(graph), weight(weight), heuristic(heuristic), //
-          g_score(graph.size(), -1) {}
+          open_set(graph.size()) {}
 
     size_t size_of() const override {
-        return Algorithm<T>::size_of() + true_size(g_score) //
-               + sizeof(open_set) + sizeof(std::vector<PQitem>) + sizeof(PQitem) * open_set.size() * 2;
+        return Algorithm<T>::size_of() + open_set.size_of();
     }
 
     void run(int source, int target, bool break_on_found = false) override {
-        open_set.push(PQitem{this->heuristic.get(source, target, source, this->graph), source});
-        g_score[source] = 0.0f;
+        this->begin();
+        open_set.clear();
+
+        open_set.push(this->heuristic.get(source, target, -1, this->graph), source);
+        this->space.set(source, 0.f, -1);
         this->mem(2);
 
         while (!open_set.empty()) {
@@ -251,47 +532,122 @@ template <typename T> class AStar : public Algorithm<T> {
             }
 
             this->trace.parent(current);
-            for (int neighbor : this->graph.adjacent(current)) {
+            for (int neighbor : this->graph.neighbors(current)) {
                 this->step();
 
-                const float w = this->weight.get(current, neighbor, this->prev[current], this->graph);
-                const float tentative_g = g_score[current] + w;
+                const float w = this->weight.get(current, neighbor, this->space.parent(current), this->graph);
+                const float tentative_g = this->space.distance(current) + w;
                 this->mem(2);
 
                 this->comp();
-                if (g_score[neighbor] < 0 || tentative_g < g_score[neighbor]) {
+                if (tentative_g < this->space.distance(neighbor)) {
                     this->trace.child(neighbor);
 
-                    this->prev[neighbor] = current;
-                    g_score[neighbor] = tentative_g;
+                    this->space.set(neighbor, tentative_g, current);
 
-                    const float f_score = tentative_g + this->heuristic.get(source, target, this->prev[current], this->graph);
-                    open_set.push({f_score, neighbor});
+                    const float f_score = tentative_g + this->heuristic.get(neighbor, target, -1, this->graph);
+                    open_set.push(f_score, neighbor);
 
                     this->mem(3);
                 }
             }
         }
     }
+
+    /**
+     * @note the estimate is the smallest one to any target plus its distance, which stays consistent;
+     * with `break_on_found` the search stops once no key in the open set can improve the best target
+     */
+    std::pair<int, int> seeded(const std::vector<typename Algorithm<T>::Seed> &sources, const std::vector<typename Algorithm<T>::Seed> &targets,
+                               bool break_on_found = false) override {
+        this->begin();
+        open_set.clear();
+
+        auto estimate = [&](int v) {
+            float h = FMAX;
+            for (const auto &t : targets)
+                h = std::min(h, this->heuristic.get(v, t.vertex, -1, this->graph) + t.distance);
+
+            return h;
+        };
+
+        for (const auto &s : sources) {
+            this->comp();
+            if (s.distance < this->space.distance(s.vertex)) {
+                this->space.set(s.vertex, s.distance, -1);
+                open_set.push(s.distance + estimate(s.vertex), s.vertex);
+                this->mem(3);
+            }
+        }
+
+        float best = FMAX;
+        int chosen = -1;
+
+        while (!open_set.empty()) {
+            const float f = open_set.top().first;
+            const int current = open_set.top().second;
+            open_set.pop();
+            this->mem();
+
+            this->comp();
+            if (break_on_found && f >= best)
+                break;
+
+            for (size_t j = 0; j < targets.size(); j++) {
+                this->comp();
+                if (targets[j].vertex == current && this->space.distance(current) + targets[j].distance < best) {
+                    best = this->space.distance(current) + targets[j].distance;
+                    chosen = j;
+                }
+            }
+
+            this->trace.parent(current);
+            for (int neighbor : this->graph.neighbors(current)) {
+                this->step();
+
+                const float w = this->weight.get(current, neighbor, this->space.parent(current), this->graph);
+                const float tentative_g = this->space.distance(current) + w;
+                this->mem(2);
+
+                this->comp();
+                if (tentative_g < this->space.distance(neighbor)) {
+                    this->trace.child(neighbor);
+
+                    this->space.set(neighbor, tentative_g, current);
+                    open_set.push(tentative_g + estimate(neighbor), neighbor);
+
+                    this->mem(3);
+                }
+            }
+        }
+
+        if (chosen < 0)
+            return {-1, -1};
+
+        return {this->root(this->space, sources, targets[chosen].vertex), chosen};
+    }
 };
 
 template <typename T> class BFS : public Algorithm<T> {
   private:
-    std::vector<bool> visited;
     std::queue<int> queue;
 
   public:
-    BFS(const DiGraph<T> &graph)
-        : Algorithm<T>(graph), //
-          visited(graph.size(), false) {}
+    BFS(const DiGraph<T> &graph) : Algorithm<T>(graph) {}
 
     size_t size_of() const override {
-        return Algorithm<T>::size_of() + true_size(visited) + sizeof(queue) + sizeof(T) * queue.size();
+        return Algorithm<T>::size_of() + sizeof(queue) + sizeof(T) * queue.size();
     }
 
+    /**
+     * @note the workspace distance of a vertex is its depth
+     */
     void run(int source, int target, bool break_on_found = false) override {
+        this->begin();
+        queue = std::queue<int>();
+
         queue.push(source);
-        visited[source] = true;
+        this->space.set(source, 0.f, -1);
 
         this->mem(2);
 
@@ -307,15 +663,14 @@ template <typename T> class BFS : public Algorithm<T> {
                 break;
             }
 
-            for (int neighbor : this->graph.adjacent(current)) {
+            for (int neighbor : this->graph.neighbors(current)) {
                 this->step();
 
                 this->comp();
-                if (!visited[neighbor]) {
+                if (!this->space.touched(neighbor)) {
                     this->trace.child(neighbor);
 
-                    visited[neighbor] = true;
-                    this->prev[neighbor] = current;
+                    this->space.set(neighbor, this->space.distance(current) + 1, current);
 
                     queue.push(neighbor);
 
@@ -328,21 +683,24 @@ template <typename T> class BFS : public Algorithm<T> {
 
 template <typename T> class DFS : public Algorithm<T> {
   private:
-    std::vector<bool> visited;
     std::stack<int> stack;
 
   public:
-    DFS(const DiGraph<T> &graph)
-        : Algorithm<T>(graph), //
-          visited(graph.size(), false) {}
+    DFS(const DiGraph<T> &graph) : Algorithm<T>(graph) {}
 
     size_t size_of() const override {
-        return Algorithm<T>::size_of() + true_size(visited) + sizeof(stack) + stack.size() * sizeof(T);
+        return Algorithm<T>::size_of() + sizeof(stack) + stack.size() * sizeof(T);
     }
 
+    /**
+     * @note the workspace distance of a vertex is its depth in the DFS tree
+     */
     void run(int source, int target, bool break_on_found = false) override {
+        this->begin();
+        stack = std::stack<int>();
+
         stack.push(source);
-        visited[source] = true;
+        this->space.set(source, 0.f, -1);
         this->mem(2);
 
         while (!stack.empty()) {
@@ -356,15 +714,14 @@ template <typename T> class DFS : public Algorithm<T> {
             if (break_on_found && current == target)
                 break;
 
-            for (int neighbor : this->graph.adjacent(current)) {
+            for (int neighbor : this->graph.neighbors(current)) {
                 this->step();
 
                 this->comp();
-                if (!visited[neighbor]) {
+                if (!this->space.touched(neighbor)) {
                     this->trace.child(neighbor);
 
-                    visited[neighbor] = true;
-                    this->prev[neighbor] = current;
+                    this->space.set(neighbor, this->space.distance(current) + 1, current);
 
                     stack.push(neighbor);
 
@@ -375,4 +732,238 @@ template <typename T> class DFS : public Algorithm<T> {
     }
 };
 
+/**
+ * @brief Bidirectional Dijkstra, or bidirectional A* when a heuristic is given
+ * A forward search from the source and a backward search (over the incoming edges) from the target are
+ * alternated, until the sum of their smallest keys proves that no shorter path can meet in the middle.
+ * The A* variant uses the average of the forward and backward potentials, so both sides stay consistent.
+ * @note turn penalties (the `prev` argument of the weight) are only known on the forward side,
+ * the backward side prices its edges without them.
+ */
+template <typename T> class Bidirectional : public Algorithm<T> {
+    const Weight<T> &weight;
+    const Weight<T> *heuristic;
+
+    /**
+     * @brief incoming edges, the backward search runs on this
+     */
+    const Transpose incoming;
+
+    // forward side uses this->space
+    LazyHeap pq_f, pq_b;
+
+    /**
+     * @brief state of the backward side, the parent of each vertex is its successor towards the target
+     */
+    Workspace backward;
+
+    /**
+     * @brief vertex where the best path found so far crosses from one search space to the other
+     */
+    int meeting = -1;
+
+    /**
+     * @brief length of the best path found so far
+     */
+    float best = FMAX;
+
+    /**
+     * @brief forward potential, the backward one is its negation
+     */
+    float potential(int v, int source, int target) const {
+        if (heuristic == nullptr)
+            return 0.f;
+
+        return (heuristic->get(v, target, -1, this->graph) - heuristic->get(source, v, -1, this->graph)) / 2.f;
+    }
+
+    /**
+     * @brief drop the already settled items from the top of the queue
+     */
+    void prune(LazyHeap &pq, const Workspace &space) {
+        while (!pq.empty() && space.settled(pq.top().second)) {
+            pq.pop();
+            this->mem();
+        }
+    }
+
+    /**
+     * @brief settle the top of one queue and relax the edges leaving it (entering it, on the backward side)
+     */
+    void expand(bool forward, int source, int target) {
+        LazyHeap &pq = forward ? pq_f : pq_b;
+        Workspace &space = forward ? this->space : backward, &other = forward ? backward : this->space;
+
+        const int current = pq.top().second;
+        pq.pop();
+        space.settle(current);
+        this->mem(2);
+
+        this->trace.parent(current);
+
+        const Neighbors neighbors = forward ? this->graph.neighbors(current) : incoming.neighbors(current);
+        for (int neighbor : neighbors) {
+            this->trace.child(neighbor);
+            this->step();
+
+            this->mem();
+            const float w = forward ? this->weight.get(current, neighbor, space.parent(current), this->graph) //
+                                    : this->weight.get(neighbor, current, -1, this->graph);
+            const float d = space.distance(current) + w;
+
+            this->comp();
+            if (d < space.distance(neighbor)) {
+                space.set(neighbor, d, current);
+
+                const float p = potential(neighbor, source, target);
+                pq.push(forward ? d + p : d - p, neighbor);
+                this->mem(3);
+            }
+
+            this->comp();
+            if (other.distance(neighbor) < FMAX && space.distance(neighbor) + other.distance(neighbor) < best) {
+                best = space.distance(neighbor) + other.distance(neighbor);
+                meeting = neighbor;
+                this->mem(2);
+            }
+        }
+    }
+
+    /**
+     * @brief alternate the two sides from the seeded queues, the potentials are taken between source and target
+     */
+    void alternate(int source, int target, bool break_on_found) {
+        while (true) {
+            prune(pq_f, this->space);
+            prune(pq_b, backward);
+
+            this->comp();
+            if (pq_f.empty() && pq_b.empty())
+                break;
+
+            // with the potentials folded into the keys, this is the classic stopping criterion
+            this->comp();
+            if (break_on_found && !pq_f.empty() && !pq_b.empty() && pq_f.top().first + pq_b.top().first >= best)
+                break;
+
+            // one side ran dry, nothing else can meet in the middle
+            this->comp();
+            if (break_on_found && (pq_f.empty() || pq_b.empty()))
+                break;
+
+            // balance the two search spaces: always expand the side with the smaller key
+            this->comp();
+            expand(pq_b.empty() || (!pq_f.empty() && pq_f.top().first <= pq_b.top().first), source, target);
+        }
+    }
+
+  public:
+    Bidirectional(const DiGraph<T> &graph, const Weight<T> &weight, const Weight<T> *heuristic = nullptr)
+        : Algorithm<T>(graph), weight(weight), heuristic(heuristic), incoming(graph), //
+          pq_f(graph.size()), pq_b(graph.size()), backward(graph.size()) {
+        this->mem(graph.size() * 5);
+    }
+
+    size_t size_of() const override {
+        return Algorithm<T>::size_of() + incoming.size_of() + backward.size_of() + pq_f.size_of() + pq_b.size_of();
+    }
+
+    void run(int source, int target, bool break_on_found = false) override {
+        this->begin();
+        backward.reset();
+        pq_f.clear();
+        pq_b.clear();
+        meeting = -1;
+        best = FMAX;
+
+        this->space.set(source, 0.f, -1);
+        backward.set(target, 0.f, -1);
+        pq_f.push(potential(source, source, target), source);
+        pq_b.push(-potential(target, source, target), target);
+        this->mem(4);
+
+        if (source == target) {
+            best = 0.f;
+            meeting = source;
+        }
+
+        alternate(source, target, break_on_found);
+    }
+
+    /**
+     * @note the potentials are taken between the first source and the first target, they stay consistent for the others
+     */
+    std::pair<int, int> seeded(const std::vector<typename Algorithm<T>::Seed> &sources, const std::vector<typename Algorithm<T>::Seed> &targets,
+                               bool break_on_found = false) override {
+        this->begin();
+        backward.reset();
+        pq_f.clear();
+        pq_b.clear();
+        meeting = -1;
+        best = FMAX;
+
+        const int source = sources.front().vertex, target = targets.front().vertex;
+
+        for (const auto &s : sources) {
+            this->comp();
+            if (s.distance < this->space.distance(s.vertex)) {
+                this->space.set(s.vertex, s.distance, -1);
+                pq_f.push(s.distance + potential(s.vertex, source, target), s.vertex);
+                this->mem(3);
+            }
+        }
+
+        for (const auto &t : targets) {
+            this->comp();
+            if (t.distance < backward.distance(t.vertex)) {
+                backward.set(t.vertex, t.distance, -1);
+                pq_b.push(t.distance - potential(t.vertex, source, target), t.vertex);
+                this->mem(3);
+            }
+
+            // a vertex that is a source and a target at once
+            this->comp();
+            if (this->space.distance(t.vertex) < FMAX && this->space.distance(t.vertex) + backward.distance(t.vertex) < best) {
+                best = this->space.distance(t.vertex) + backward.distance(t.vertex);
+                meeting = t.vertex;
+            }
+        }
+
+        alternate(source, target, break_on_found);
+
+        if (meeting < 0)
+            return {-1, -1};
+
+        return {this->root(this->space, sources, meeting), this->root(backward, targets, meeting)};
+    }
+
+    /**
+     * @brief join the forward path up to the meeting point with the backward path down from it
+     */
+    std::vector<int> reconstruct(int source, int target) const override {
+        std::vector<int> path;
+
+        if (meeting < 0) {
+            std::cerr << "No route to point\n";
+            return path;
+        }
+
+        for (int u = meeting; u >= 0; u = this->space.parent(u)) {
+            path.push_back(u);
+            if (u == source)
+                break;
+        }
+
+        std::reverse(path.begin(), path.end());
+
+        for (int u = backward.parent(meeting); u >= 0; u = backward.parent(u)) {
+            path.push_back(u);
+            if (u == target)
+                break;
+        }
+
+        return path;
+    }
+};
+
 #endif // ALGO_H
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "algorithm.h"
+#include "cli.h"
+#include "components.h"
+#include "geo.h"
+#include "lib.h"
+#include "spatial.h"
+#include "weights.h"
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Batch mode: route many source/target pairs with one loaded graph, without the GUI
+ */
+namespace batch {
+
+struct Query {
+    Point source, target;
+};
+
+/**
+ * @brief Read the queries, one per line: `src_lat,src_lon,dst_lat,dst_lon`
+ * The two points may also be separated by whitespace or ';' (then DMS coordinates work as well).
+ * Empty lines, lines starting with '#' and a header line are skipped.
+ * @throws std::invalid_argument on a malformed line
+ */
+std::vector<Query> read(const std::string &filename);
+
+/**
+ * @brief Creates a new algorithm instance, one is made for every worker thread
+ */
+using Factory = std::function<Algorithm<Node> *()>;
+
+/**
+ * @brief Snap every query to the graph, route it, and write one record per query to `os`, in the order of the queries
+ * The queries are handed out to the worker threads in small chunks. Every worker owns an algorithm instance
+ * (and so its workspace), reused for all of its queries, while the graph and the weights are shared read-only.
+ * The endpoints are snapped to the closest vertices of the largest component with the spatial index, see `snap`.
+ * Records: id, source and target vertex, found, distance (m), time (s), steps, comparisons, memory operations, search time (ms)
+ * @param roads road of every edge on merged graphs, see `measure`
+ * @param threads number of workers, at least 1
+ */
+void run(const std::vector<Query> &queries, const DiGraph<Node> &graph, const EdgeRoads *roads, const KDTree<Node> &index, const Components<Node> &components, const Factory &create, unsigned int threads, cli::Format format, std::ostream &os);
+
+} // namespace batch
+
+#endif // BATCH_H
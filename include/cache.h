@@ -0,0 +1,97 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "geo.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary cache of the parsed roads (format v2)
+ * Layout, every section aligned to 8 bytes:
+ * - header: magic, version, size and modification time of the source map, section sizes, checksum
+ * - points: longitude/latitude float pairs of every road, road after road (the point array of `Roads` as it is)
+ * - roads: fixed size records, referring to a range of points and to the string table
+ * - strings: names and refs, each distinct string stored once
+ * The sections are flat arrays, so a reader can map the file and use them in place: `read` keeps the file mapped in
+ * `Roads`, the points section is the point array of the map, and names and refs are views into the string table.
+ */
+namespace cache {
+
+static const uint32_t MAGIC = 0x3243414e; // "NAC2"
+static const uint32_t VERSION = 2;
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+
+    /**
+     * @brief size and modification time of the map the cache was made of
+     */
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    uint64_t points;
+    uint64_t roads;
+    uint64_t string_bytes;
+
+    /**
+     * @brief checksum of everything after the header
+     */
+    uint64_t checksum;
+};
+
+/**
+ * @brief road attributes, in the roads section
+ */
+struct RoadRecord {
+    uint32_t id;
+
+    /**
+     * @brief range in the points section
+     */
+    uint32_t first_point, point_count;
+
+    /**
+     * @brief ranges in the string table
+     */
+    uint32_t name_offset, name_length;
+    uint32_t ref_offset, ref_length;
+
+    int32_t maxspeed;
+    int32_t lanes;
+
+    uint8_t highway;
+
+    /**
+     * @brief roundabout, oneway, bridge, toll, lit (from the lowest bit)
+     */
+    uint8_t flags;
+
+    uint16_t reserved;
+};
+
+/**
+ * @brief Size and modification time of a file, used to tell if files derived from it are stale
+ * @returns false if the file doesn't exist
+ */
+bool stamp(const std::string &source, uint64_t &size, int64_t &mtime);
+
+/**
+ * @brief Write the roads parsed from `source` to `filename`
+ * @returns false if the file could not be written
+ */
+bool write(const std::string &filename, const std::string &source, const Roads &roads);
+
+/**
+ * @brief Load the roads from `filename`, if it is a valid cache of the current version of `source`
+ * @returns false (and leaves roads untouched) if the cache is missing, outdated, truncated or corrupt, or `roads` is
+ * not empty
+ * @note if the map itself is missing, the cache is used as it is
+ */
+bool read(const std::string &filename, const std::string &source, Roads &roads);
+
+} // namespace cache
+
+#endif // CACHE_H
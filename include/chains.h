@@ -0,0 +1,492 @@
+#ifndef CHAINS_H
+#define CHAINS_H
+
+#include "algorithm.h"
+#include "diagnostics.h"
+#include "geo.h"
+#include "lib.h"
+#include "util.h"
+
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Degree-2 chains of a graph, and the graph of the junctions they connect
+ * Most vertices only continue a road: they are linked to exactly two others, either both ways or one way through.
+ * A chain runs from a junction (any other vertex) through such vertices to the next junction. The compressed graph
+ * keeps every vertex, so the indices stay the same, but it only links the junctions: one edge for every pair of
+ * junctions connected by a chain.
+ */
+template <typename T> class Chains : Sizable {
+    /**
+     * @brief vertices of every chain, from its first junction to its last (CSR)
+     */
+    std::vector<int> offsets, vertices;
+
+    /**
+     * @brief the chains of every compressed edge: the first one, the others are linked through `following`
+     */
+    EdgeMap<int> first;
+    std::vector<int> following;
+
+    /**
+     * @brief the (at most two, one per direction) chains running through every vertex, -1 for junctions
+     */
+    std::vector<int> through[2];
+
+    /**
+     * @brief position of the vertex in the chains it runs through
+     */
+    std::vector<int> position[2];
+
+    DiGraph<T> compressed;
+
+    /**
+     * @returns true, if v is linked to exactly two vertices: both ways to both of them, or one way through
+     */
+    static bool inner(const DiGraph<T> &graph, const Transpose &transpose, int v) {
+        int a = -1, b = -1;
+        bool many = false;
+
+        auto note = [&](int w) {
+            if (w == v || w == a || w == b)
+                return;
+
+            if (a < 0)
+                a = w;
+            else if (b < 0)
+                b = w;
+            else
+                many = true;
+        };
+
+        for (int w : graph.neighbors(v))
+            note(w);
+        for (int w : transpose.neighbors(v))
+            note(w);
+
+        if (many || b < 0)
+            return false;
+
+        bool to_a = false, to_b = false, from_a = false, from_b = false;
+        for (int w : graph.neighbors(v))
+            to_a |= w == a, to_b |= w == b;
+        for (int w : transpose.neighbors(v))
+            from_a |= w == a, from_b |= w == b;
+
+        return (to_a && to_b && from_a && from_b) || //
+               (from_a && to_b && !to_a && !from_b) || //
+               (from_b && to_a && !to_b && !from_a);
+    }
+
+  public:
+    Chains(const DiGraph<T> &graph) : offsets(1, 0), compressed(graph.vtx(), graph.driver) {
+        const size_t n = graph.size();
+        const Transpose transpose(graph);
+
+        std::vector<bool> interior(n);
+        for (size_t v = 0; v < n; v++)
+            interior[v] = inner(graph, transpose, v);
+
+        // a chain leading back to its own junction can't be an edge of the compressed graph, so its vertices are made
+        // junctions (linked by their plain edges), as are the ones of rings without any junction; then walk again
+        for (bool again = true; again;) {
+            again = false;
+            offsets.assign(1, 0);
+            vertices.clear();
+
+            std::vector<bool> covered(n, false);
+
+            // walk from every junction along each of its edges, until the next junction
+            for (size_t u = 0; u < n; u++) {
+                if (interior[u])
+                    continue;
+
+                for (int w : graph.neighbors(u)) {
+                    if (w == (int)u)
+                        continue;
+
+                    const size_t begin = vertices.size();
+                    vertices.push_back(u);
+
+                    int prev = u, current = w;
+                    while (interior[current]) {
+                        vertices.push_back(current);
+
+                        // the way on: the other neighbor (the only one on one-way chains)
+                        for (int x : graph.neighbors(current)) {
+                            if (x != prev && x != current) {
+                                prev = current;
+                                current = x;
+                                break;
+                            }
+                        }
+                    }
+
+                    if (current == (int)u) {
+                        for (size_t k = begin + 1; k < vertices.size(); k++)
+                            interior[vertices[k]] = false;
+
+                        vertices.resize(begin);
+                        again = true;
+                        continue;
+                    }
+
+                    for (size_t k = begin + 1; k < vertices.size(); k++)
+                        covered[vertices[k]] = true;
+
+                    vertices.push_back(current);
+                    offsets.push_back(vertices.size());
+                }
+            }
+
+            for (size_t v = 0; v < n; v++) {
+                if (interior[v] && !covered[v]) {
+                    interior[v] = false;
+                    again = true;
+                }
+            }
+        }
+
+        for (size_t c = 0; c < count(); c++)
+            compressed.edge(at(c, 0), at(c, length(c) - 1));
+
+        compressed.freeze();
+
+        first = EdgeMap<int>(compressed, -1);
+        following.assign(count(), -1);
+
+        for (int i = 0; i < 2; i++) {
+            through[i].assign(n, -1);
+            position[i].assign(n, -1);
+        }
+
+        for (size_t c = 0; c < count(); c++) {
+            const int edge = first.find(at(c, 0), at(c, length(c) - 1));
+            following[c] = first[edge];
+            first[edge] = c;
+
+            for (int k = 1; k + 1 < length(c); k++) {
+                const int v = at(c, k);
+                const int slot = through[0][v] < 0 ? 0 : 1;
+
+                through[slot][v] = c;
+                position[slot][v] = k;
+            }
+        }
+    }
+
+    size_t size_of() const override {
+        return true_size(offsets) + true_size(vertices) + first.size_of() + true_size(following) + //
+               2 * (true_size(through[0]) + true_size(position[0])) + compressed.size_of();
+    }
+
+    /**
+     * @brief the graph of the junctions, with the same vertices as the full graph
+     */
+    const DiGraph<T> &graph() const {
+        return compressed;
+    }
+
+    /**
+     * @returns number of chains
+     */
+    size_t count() const {
+        return offsets.size() - 1;
+    }
+
+    /**
+     * @returns number of vertices of a chain, both junctions included
+     */
+    int length(int chain) const {
+        return offsets[chain + 1] - offsets[chain];
+    }
+
+    /**
+     * @returns the k-th vertex of a chain
+     */
+    int at(int chain, int k) const {
+        return vertices[offsets[chain] + k];
+    }
+
+    /**
+     * @returns the first of the chains behind a compressed edge, -1 if there is none
+     */
+    int chain(int from, int to) const {
+        const int edge = first.find(from, to);
+        return edge < 0 ? -1 : first[edge];
+    }
+
+    /**
+     * @returns the next chain linking the same two junctions, -1 after the last one
+     */
+    int next(int chain) const {
+        return following[chain];
+    }
+
+    bool junction(int v) const {
+        return through[0][v] < 0;
+    }
+
+    /**
+     * @returns the chain running through v (slot 0 or 1), -1 if there is none
+     */
+    int through_chain(int v, int slot) const {
+        return through[slot][v];
+    }
+
+    /**
+     * @returns position of v in its chain of the slot
+     */
+    int position_in(int v, int slot) const {
+        return position[slot][v];
+    }
+};
+
+/**
+ * @brief Weight of the compressed graph: the sum of the weights along the chain of an edge
+ * Where several chains link the same two junctions, the lightest one is used (and expanded).
+ * Everything but the first edge of a chain is summed up front, the first one is weighed when asked,
+ * so that a turn at the junction is taken from the actual previous point.
+ */
+template <typename T> class ChainWeight final : public Weight<T> {
+    const Chains<T> &chains;
+    const DiGraph<T> &full;
+    const Weight<T> &base;
+
+    /**
+     * @brief weight of every chain, without its first edge
+     */
+    std::vector<float> rest;
+
+    /**
+     * @brief the lightest chain of every compressed edge
+     */
+    EdgeMap<int> best;
+
+  public:
+    ChainWeight(const Chains<T> &chains, const DiGraph<T> &full, const Weight<T> &base)
+        : chains(chains), full(full), base(base), rest(chains.count(), 0.f), best(chains.graph(), -1) {
+        for (size_t c = 0; c < chains.count(); c++)
+            for (int k = 2; k < chains.length(c); k++)
+                rest[c] += base.get(chains.at(c, k - 1), chains.at(c, k), chains.at(c, k - 2), full);
+
+        const DiGraph<T> &graph = chains.graph();
+        for (size_t u = 0; u < graph.size(); u++) {
+            for (int v : graph.neighbors(u)) {
+                float lightest = FMAX;
+                int &chosen = best[best.find(u, v)];
+
+                for (int c = chains.chain(u, v); c >= 0; c = chains.next(c)) {
+                    const float w = base.get(u, chains.at(c, 1), -1, full) + rest[c];
+
+                    if (w < lightest) {
+                        lightest = w;
+                        chosen = c;
+                    }
+                }
+            }
+        }
+    }
+
+    float get(const T &from, const T &to, const T *prev) const override {
+        return base.get(from, to, prev);
+    }
+
+    float get(int from, int to, int prev, const DiGraph<T> &graph) const override {
+        const int c = chain(from, to);
+        if (c < 0)
+            return base.get(from, to, prev, full);
+
+        // the point before the junction, on the chain that lead there
+        int before = -1;
+        if (prev >= 0) {
+            const int p = chain(prev, from);
+            if (p >= 0)
+                before = chains.at(p, chains.length(p) - 2);
+        }
+
+        return base.get(from, chains.at(c, 1), before, full) + rest[c];
+    }
+
+    /**
+     * @returns the chain a compressed edge stands for, -1 if there is no such edge
+     */
+    int chain(int from, int to) const {
+        const int edge = best.find(from, to);
+        return edge < 0 ? -1 : best[edge];
+    }
+
+    /**
+     * @returns weight of a piece of a chain, between two positions; the turn before the first edge is not known
+     */
+    float along(int chain, int begin, int end) const {
+        float w = 0.f;
+        for (int k = begin + 1; k <= end; k++)
+            w += base.get(chains.at(chain, k - 1), chains.at(chain, k), k - 2 >= begin ? chains.at(chain, k - 2) : -1, full);
+
+        return w;
+    }
+};
+
+/**
+ * @brief Search on the compressed graph, with the found route expanded back to every vertex of the full graph
+ * A source inside a chain can leave it at the far junction of either chain running through it, and a target inside one
+ * can be reached from the near junction of either: the search starts from every such junction at the weight of its piece
+ * of chain, and ends at the one giving the shortest route, so the route is the same as on the full graph.
+ */
+template <typename T> class Compressed : public Algorithm<T> {
+    using Seed = typename Algorithm<T>::Seed;
+
+    /**
+     * @brief search on the compressed graph, owned
+     */
+    Algorithm<T> *search;
+
+    const Chains<T> &chains;
+    const ChainWeight<T> &weight;
+
+    /**
+     * @brief the junctions searched between in the last run, and the pieces of chains leading to and from them
+     */
+    int from = -1, to = -1;
+    std::vector<int> head, tail;
+
+    /**
+     * @brief the source and the target of the last run are on the same chain, in order
+     */
+    bool direct = false;
+
+    /**
+     * @brief the junctions the search can start from (leaving v) or end at (reaching v), weighted by their piece of chain
+     * @param slots the slot of the chain of every seed, -1 if v is a junction itself
+     */
+    std::vector<Seed> seeds(int v, bool leaving, std::vector<int> &slots) const {
+        std::vector<Seed> found;
+        slots.clear();
+
+        for (int s = 0; s < 2; s++) {
+            const int c = chains.through_chain(v, s);
+            if (c < 0)
+                continue;
+
+            const int k = chains.position_in(v, s), last = chains.length(c) - 1;
+            found.push_back(leaving ? Seed{chains.at(c, last), weight.along(c, k, last)} : Seed{chains.at(c, 0), weight.along(c, 0, k)});
+            slots.push_back(s);
+        }
+
+        if (found.empty()) {
+            found.push_back(Seed{v, 0.f});
+            slots.push_back(-1);
+        }
+
+        return found;
+    }
+
+  public:
+    /**
+     * @param search algorithm running on the compressed graph, owned from now on
+     */
+    Compressed(Algorithm<T> *search, const Chains<T> &chains, const ChainWeight<T> &weight)
+        : Algorithm<T>(chains.graph()), search(search), chains(chains), weight(weight) {}
+
+    size_t size_of() const override {
+        return search->size_of() + true_size(head) + true_size(tail);
+    }
+
+    void record(bool on) override {
+        Algorithm<T>::record(on);
+        search->record(on);
+    }
+
+    void run(int source, int target, bool break_on_found = false) override {
+        head.clear();
+        tail.clear();
+        direct = false;
+
+        // on the same chain, in order: no need for a search
+        for (int s = 0; s < 2 && !direct; s++) {
+            for (int t = 0; t < 2 && !direct; t++) {
+                const int c = chains.through_chain(source, s);
+
+                if (c >= 0 && c == chains.through_chain(target, t) && chains.position_in(source, s) <= chains.position_in(target, t)) {
+                    for (int k = chains.position_in(source, s); k <= chains.position_in(target, t); k++)
+                        head.push_back(chains.at(c, k));
+
+                    direct = true;
+                }
+            }
+        }
+
+        if (direct) {
+            this->begin();
+            this->reset();
+            return;
+        }
+
+        std::vector<int> leaving, reaching;
+        const std::vector<Seed> sources = seeds(source, true, leaving), targets = seeds(target, false, reaching);
+
+        search->reset();
+        std::pair<int, int> chosen = search->seeded(sources, targets, break_on_found);
+
+        // without a route the search is asked to reconstruct it anyway, to report it
+        if (chosen.first < 0 || chosen.second < 0)
+            chosen = {0, 0};
+
+        from = sources[chosen.first].vertex;
+        if (leaving[chosen.first] >= 0) {
+            const int s = leaving[chosen.first], c = chains.through_chain(source, s);
+            for (int k = chains.position_in(source, s); k < chains.length(c); k++)
+                head.push_back(chains.at(c, k));
+        }
+
+        to = targets[chosen.second].vertex;
+        if (reaching[chosen.second] >= 0) {
+            const int t = reaching[chosen.second], c = chains.through_chain(target, t);
+            for (int k = 0; k <= chains.position_in(target, t); k++)
+                tail.push_back(chains.at(c, k));
+        }
+
+        static_cast<Counter &>(*this) = *search;
+        // the trace is handed over, not copied: the search drops it at its next run anyway
+        std::swap(this->trace, search->trace);
+    }
+
+    std::vector<int> reconstruct(int source, int target) const override {
+        if (direct)
+            return head;
+
+        const std::vector<int> route = search->reconstruct(from, to);
+        if (route.empty())
+            return route;
+
+        std::vector<int> path;
+        if (!head.empty())
+            path.assign(head.begin(), head.end() - 1);
+
+        path.push_back(route.front());
+        for (size_t i = 1; i < route.size(); i++) {
+            const int c = weight.chain(route[i - 1], route[i]);
+
+            if (c < 0) {
+                path.push_back(route[i]);
+                continue;
+            }
+
+            for (int k = 1; k < chains.length(c); k++)
+                path.push_back(chains.at(c, k));
+        }
+
+        if (!tail.empty())
+            path.insert(path.end(), tail.begin() + 1, tail.end());
+
+        return path;
+    }
+
+    ~Compressed() {
+        delete search;
+    }
+};
+
+#endif // CHAINS_H
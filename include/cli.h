@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <thread>
 
 namespace cli {
 
@@ -28,19 +29,67 @@ Usage:
         Loads the map. Expected format: newline-delimited GeoJSON (GeoJSONL).
         Tip: Many major cities are available for download here: https://app.interline.io/osm_extracts/interactive_view
 
-  --algo <astar|dijkstra|bfs|dfs>
+  --algo <astar|dijkstra|bfs|dfs|bidijkstra|biastar|ch>
         Specifies the graph traversal algorithm to use. Supported algorithms:
         - A* Search
         - Dijkstra's Algorithm
         - Breadth-First Search (BFS)
         - Depth-First Search (DFS)
-
-  --struct <list|matrix>
-        Chooses the data structure for representing the graph: adjacency list or adjacency matrix.
+        - Bidirectional Dijkstra and bidirectional A* (searching from both ends at once)
+        - Contraction Hierarchies (preprocessed once per map and routing option, saved next to the map)
+
+  --struct <list|matrix|csr>
+        Chooses the data structure for representing the graph: adjacency list, adjacency matrix or compressed sparse row.
+
+  --merge
+        Builds one vertex per location: the coincident points of intersecting roads are merged,
+        instead of being linked by zero-length edges. Every edge keeps the road it belongs to.
+
+  --compress
+        Searches on the graph of the junctions only: the vertices that merely continue a road are collapsed
+        into one edge per chain, carrying the weight of the whole chain. The route is expanded back afterwards.
+
+  --prune
+        Keeps only the largest strongly connected component of the graph, so every pair of vertices has a route.
+        Without it, pairs that certainly have no route are rejected without a search.
+
+  --heap <lazy|dary|radix>
+        Priority queue used by Dijkstra and A*:
+        - lazy: binary heap, every improvement is pushed again and outdated items are skipped (default)
+        - dary: 4-ary heap with decrease-key, every vertex is queued at most once
+        - radix: monotone radix heap, amortized O(1) operations without comparisons (dijkstra only)
+
+  --landmarks <count>
+        Number of landmarks for the A* heuristic (ALT), 16 by default. The distances to and from them
+        are precomputed once per map and routing option, and saved next to the map.
+        0 falls back to the plain geometric estimate.
+
+  --batch <queries.csv>
+        Routes every query of the file instead of a single one, without opening a window.
+        One query per line: `src_lat,src_lon,dst_lat,dst_lon`. The map and the graph are loaded only once,
+        the results (distance, time and search statistics per query) are written to the standard output.
+
+  --matrix <sources.csv> <targets.csv>
+        Computes the distance and time matrix from every source to every target, without opening a window.
+        One point per line: `lat,lon`. With `--algo ch` every source meets all targets in buckets filled by
+        the backward searches of the targets, otherwise one Dijkstra per source runs until every target is settled.
+        The matrices are written to the standard output.
+
+  --format <csv|json|binary>
+        Output format of the batch and the matrix mode, csv by default. binary is only for the matrix:
+        a header, then the distances and the times as float32 matrices.
+
+  --threads <count>
+        Number of worker threads routing the queries of the batch mode (the sources of the matrix), 1 by default.
+        0 uses every hardware thread.
 
   --trace-rate <ticks/sec>
         Sets the animation speed for discovered edges.
 
+  --no-trace
+        The search doesn't record the edges it discovers, only the route is drawn.
+        Saves the memory of the trace on large maps.
+
   --route-rate <ticks/sec>
         Sets the animation speed for the planned route.
 
@@ -63,6 +112,15 @@ Usage:
         Displays this help message.
 )";
 
+/**
+ * @brief Output format of the batch and the matrix mode
+ */
+enum class Format {
+    CSV,
+    JSON,
+    Binary,
+};
+
 struct Options {
     /**
      * @brief soure and target nodes of the search
@@ -74,26 +132,76 @@ struct Options {
      */
     unsigned int trace_rate, route_rate;
 
+    /**
+     * @brief record the trace of the search, to animate it
+     */
+    bool trace;
+
     /**
      * @brief map to load (.geojsonl file)
      */
     std::string map;
 
     /**
-     * @brief Directed Graph structure: List, or Matrix
+     * @brief Directed Graph structure: List, Matrix or CSR
      */
     DiGraph<Node>::Driver graph;
 
+    /**
+     * @brief Merge the coincident points of roads into one vertex
+     */
+    bool merge;
+
+    /**
+     * @brief Search on the graph of junctions, with the degree-2 chains collapsed
+     */
+    bool compress;
+
+    /**
+     * @brief Keep only the largest strongly connected component of the graph
+     */
+    bool prune;
+
     /**
      * @brief Algorithm to use
      */
     Algorithm<Node>::Driver algorithm;
 
+    /**
+     * @brief Priority queue used by Dijkstra and A*
+     */
+    HeapType heap;
+
+    /**
+     * @brief Number of landmarks used by the A* heuristic, 0 to use the geometric one
+     */
+    unsigned int landmarks;
+
     /**
      * @brief Routing options: can be Fastest, Shortest or Custom
      */
     RouteOpt routing;
 
+    /**
+     * @brief file of queries to route without the GUI, empty for the interactive mode
+     */
+    std::string batch;
+
+    /**
+     * @brief files of the sources and the targets of the distance matrix, empty if no matrix is asked for
+     */
+    std::string sources, targets;
+
+    /**
+     * @brief output format of the batch and the matrix mode
+     */
+    Format format;
+
+    /**
+     * @brief number of worker threads of the batch mode
+     */
+    unsigned int threads;
+
     /**
      * @brief Routing coefficients for Custom routing
      */
@@ -128,10 +236,21 @@ inline Options parse(int argc, char *argv[]) {
         .target = 0,
         .trace_rate = 1000,
         .route_rate = 10,
+        .trace = true,
         .map = "data/budapest.roads.geojsonl",
         .graph = DiGraph<Node>::Driver::List,
+        .merge = false,
+        .compress = false,
+        .prune = false,
         .algorithm = Algorithm<Node>::Driver::AStar,
+        .heap = HeapType::Lazy,
+        .landmarks = 16,
         .routing = RouteOpt::Custom,
+        .batch = "",
+        .sources = "",
+        .targets = "",
+        .format = Format::CSV,
+        .threads = 1,
         .coeffs = nullptr,
     };
 
@@ -171,15 +290,83 @@ inline Options parse(int argc, char *argv[]) {
                 opts.algorithm = Algorithm<Node>::Driver::BFS;
             else if (!strcmp(argv[i + 1], "dfs"))
                 opts.algorithm = Algorithm<Node>::Driver::DFS;
+            else if (!strcmp(argv[i + 1], "bidijkstra"))
+                opts.algorithm = Algorithm<Node>::Driver::BiDijkstra;
+            else if (!strcmp(argv[i + 1], "biastar"))
+                opts.algorithm = Algorithm<Node>::Driver::BiAStar;
+            else if (!strcmp(argv[i + 1], "ch"))
+                opts.algorithm = Algorithm<Node>::Driver::CH;
             else {
                 std::cerr << "Invalid algorithm driver '" << argv[i + 1] << "'\n"
-                          << "Valid options are: astar, dijkstra, bfs, dfs\n";
+                          << "Valid options are: astar, dijkstra, bfs, dfs, bidijkstra, biastar, ch\n";
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            break;
+
+        case hash("--heap", 6):
+            check(argc, i + 1);
+
+            if (!strcmp(argv[i + 1], "lazy"))
+                opts.heap = HeapType::Lazy;
+            else if (!strcmp(argv[i + 1], "dary"))
+                opts.heap = HeapType::Dary;
+            else if (!strcmp(argv[i + 1], "radix"))
+                opts.heap = HeapType::Radix;
+            else {
+                std::cerr << "Invalid heap '" << argv[i + 1] << "'\n"
+                          << "Valid options are: lazy, dary, radix\n";
                 exit(EXIT_FAILURE);
             }
 
             i++;
             break;
 
+        case hash("--landmarks", 11):
+            check(argc, i + 1);
+            opts.landmarks = Parser::as_stream<int>(argv[++i]);
+            break;
+
+        case hash("-b", 2):
+        case hash("--batch", 7):
+            check(argc, i + 1);
+            opts.batch = std::string(argv[++i]);
+            break;
+
+        case hash("--matrix", 8):
+            check(argc, i + 2);
+            opts.sources = std::string(argv[++i]);
+            opts.targets = std::string(argv[++i]);
+            break;
+
+        case hash("--format", 8):
+            check(argc, i + 1);
+
+            if (!strcmp(argv[i + 1], "csv"))
+                opts.format = Format::CSV;
+            else if (!strcmp(argv[i + 1], "json"))
+                opts.format = Format::JSON;
+            else if (!strcmp(argv[i + 1], "binary"))
+                opts.format = Format::Binary;
+            else {
+                std::cerr << "Invalid output format '" << argv[i + 1] << "'\n"
+                          << "Valid options are: csv, json, binary\n";
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            break;
+
+        case hash("-j", 2):
+        case hash("--threads", 9):
+            check(argc, i + 1);
+            opts.threads = Parser::as_stream<int>(argv[++i]);
+
+            if (opts.threads == 0)
+                opts.threads = std::max(1u, std::thread::hardware_concurrency());
+            break;
+
         case hash("--route-rate", 12):
             check(argc, i + 1);
             opts.route_rate = Parser::as_stream<int>(argv[++i]);
@@ -190,6 +377,10 @@ inline Options parse(int argc, char *argv[]) {
             opts.trace_rate = Parser::as_stream<int>(argv[++i]);
             break;
 
+        case hash("--no-trace", 10):
+            opts.trace = false;
+            break;
+
         case hash("--driver", 8):
         case hash("--struct", 8):
             check(argc, i + 1);
@@ -198,15 +389,29 @@ inline Options parse(int argc, char *argv[]) {
                 opts.graph = DiGraph<Node>::Driver::List;
             } else if (!strcmp(argv[i + 1], "matrix")) {
                 opts.graph = DiGraph<Node>::Driver::Matrix;
+            } else if (!strcmp(argv[i + 1], "csr")) {
+                opts.graph = DiGraph<Node>::Driver::CSR;
             } else {
                 std::cerr << "Invalid graph driver '" << argv[i + 1] << "'\n"
-                          << "Valid options are: list, matrix\n";
+                          << "Valid options are: list, matrix, csr\n";
                 exit(EXIT_FAILURE);
             }
 
             i++;
             break;
 
+        case hash("--merge", 7):
+            opts.merge = true;
+            break;
+
+        case hash("--compress", 10):
+            opts.compress = true;
+            break;
+
+        case hash("--prune", 7):
+            opts.prune = true;
+            break;
+
         case hash("-r", 2):
         case hash("--route", 7):
         case hash("--routing", 9):
@@ -248,6 +453,31 @@ inline Options parse(int argc, char *argv[]) {
         }
     }
 
+    const bool matrix = !opts.sources.empty();
+
+    if (matrix && !opts.batch.empty()) {
+        std::cerr << "--batch and --matrix can't be used together\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // the chains would have to be entered and left at every source and target
+    if (matrix && opts.compress) {
+        std::cerr << "--compress can't be used with --matrix\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (!matrix && opts.format == Format::Binary) {
+        std::cerr << "The binary format is only for --matrix\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // A* keys are only monotone with a consistent heuristic, which the weights don't guarantee
+    // (the matrix runs Dijkstra unless it is asked for CH)
+    if (opts.heap == HeapType::Radix && opts.algorithm != Algorithm<Node>::Driver::Dijkstra && !matrix) {
+        std::cerr << "The radix heap can only be used with dijkstra\n";
+        exit(EXIT_FAILURE);
+    }
+
     return opts;
 }
 
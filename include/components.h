@@ -0,0 +1,237 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "algorithm.h"
+#include "diagnostics.h"
+#include "lib.h"
+#include "util.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Strongly connected components of a graph (Tarjan's algorithm, without recursion)
+ * Tarjan finds the components in reverse topological order: a component is only finished after every component
+ * it leads to, so an edge never goes from a component to one with a greater number. A target in a component
+ * numbered greater than the source's can't be reached, which is told in O(1).
+ */
+template <typename T> class Components : Sizable {
+    /**
+     * @brief component of every vertex
+     */
+    std::vector<int> label;
+
+    /**
+     * @brief number of vertices of every component
+     */
+    std::vector<int> sizes;
+
+    int biggest = -1;
+
+    /**
+     * @brief count the vertices of the components, and find the largest one
+     */
+    void measure() {
+        sizes.clear();
+        biggest = -1;
+
+        for (int c : label) {
+            if (c >= (int)sizes.size())
+                sizes.resize(c + 1, 0);
+
+            sizes[c]++;
+        }
+
+        for (size_t c = 0; c < sizes.size(); c++)
+            if (biggest < 0 || sizes[c] > sizes[biggest])
+                biggest = c;
+    }
+
+  public:
+    Components() {}
+
+    /**
+     * @param label component of every vertex, as labeled by Tarjan's algorithm before (eg. loaded from a file)
+     */
+    explicit Components(std::vector<int> label) : label(std::move(label)) {
+        measure();
+    }
+
+    Components(const DiGraph<T> &graph) : label(graph.size(), -1) {
+        const int n = graph.size();
+
+        std::vector<int> index(n, -1), low(n);
+        std::vector<int> stack;
+        int counter = 0, components = 0;
+
+        struct Frame {
+            int v;
+            Neighbors::iterator it, end;
+        };
+
+        std::vector<Frame> frames;
+
+        auto visit = [&](int v) {
+            index[v] = low[v] = counter++;
+            stack.push_back(v);
+
+            const Neighbors neighbors = graph.neighbors(v);
+            frames.push_back(Frame{v, neighbors.begin(), neighbors.end()});
+        };
+
+        for (int source = 0; source < n; source++) {
+            if (index[source] >= 0)
+                continue;
+
+            visit(source);
+
+            while (!frames.empty()) {
+                Frame &frame = frames.back();
+
+                if (frame.it != frame.end) {
+                    const int w = *frame.it;
+                    ++frame.it;
+
+                    if (index[w] < 0)
+                        visit(w);
+                    else if (label[w] < 0) // still on the stack
+                        low[frame.v] = std::min(low[frame.v], index[w]);
+
+                    continue;
+                }
+
+                const int v = frame.v;
+                frames.pop_back();
+
+                if (!frames.empty())
+                    low[frames.back().v] = std::min(low[frames.back().v], low[v]);
+
+                // v is the root of a component: everything above it on the stack belongs to it
+                if (low[v] == index[v]) {
+                    const int component = components++;
+                    int w;
+
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+
+                        label[w] = component;
+                    } while (w != v);
+                }
+            }
+        }
+
+        measure();
+    }
+
+    size_t size_of() const override {
+        return true_size(label) + true_size(sizes);
+    }
+
+    /**
+     * @returns number of components
+     */
+    size_t count() const {
+        return sizes.size();
+    }
+
+    /**
+     * @returns the component of every vertex
+     */
+    const std::vector<int> &labels() const {
+        return label;
+    }
+
+    /**
+     * @returns the component of a vertex
+     */
+    int component(int v) const {
+        return label[v];
+    }
+
+    /**
+     * @returns number of vertices in a component
+     */
+    int size(int component) const {
+        return sizes[component];
+    }
+
+    /**
+     * @returns the component with the most vertices, -1 for an empty graph
+     */
+    int largest() const {
+        return biggest;
+    }
+
+    /**
+     * @returns false if there is certainly no path from `from` to `to`; true if there may be one
+     * (always true within a component)
+     */
+    bool reachable(int from, int to) const {
+        return label[from] >= label[to];
+    }
+};
+
+/**
+ * @brief Rejects the queries whose target can't be reached from the source, before running the search
+ */
+template <typename T> class Reachable : public Algorithm<T> {
+    /**
+     * @brief the actual search, owned
+     */
+    Algorithm<T> *search;
+
+    const Components<T> &components;
+
+    /**
+     * @brief the last query was rejected
+     */
+    bool rejected = false;
+
+  public:
+    /**
+     * @param search algorithm to run the queries that may have a route, owned from now on
+     */
+    Reachable(Algorithm<T> *search, const DiGraph<T> &graph, const Components<T> &components)
+        : Algorithm<T>(graph), search(search), components(components) {}
+
+    size_t size_of() const override {
+        return search->size_of();
+    }
+
+    void record(bool on) override {
+        Algorithm<T>::record(on);
+        search->record(on);
+    }
+
+    void run(int source, int target, bool break_on_found = false) override {
+        rejected = !components.reachable(source, target);
+
+        if (rejected) {
+            this->begin();
+            this->reset();
+            return;
+        }
+
+        search->reset();
+        search->run(source, target, break_on_found);
+
+        static_cast<Counter &>(*this) = *search;
+        // the trace is handed over, not copied: the search drops it at its next run anyway
+        std::swap(this->trace, search->trace);
+    }
+
+    std::vector<int> reconstruct(int source, int target) const override {
+        if (rejected)
+            return std::vector<int>();
+
+        return search->reconstruct(source, target);
+    }
+
+    ~Reachable() {
+        delete search;
+    }
+};
+
+#endif // COMPONENTS_H
@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 
 class Bench {
@@ -42,48 +43,68 @@ struct Sizable {
     virtual size_t size_of() const = 0;
 };
 
+/**
+ * @brief Counting the work of the searches is a build option (cmake -DCOUNTERS=OFF), on by default
+ * Without it the counting calls compile to nothing, so the raw speed of the searches can be measured;
+ * the counters are then left at 0.
+ */
+#ifndef NHF_COUNTERS
+#define NHF_COUNTERS 1
+#endif
+
 struct Counter {
+    /**
+     * @brief the counters are incremented in this build
+     */
+    static constexpr bool enabled = NHF_COUNTERS;
+
     /**
      * @brief number of steps
      */
-    unsigned int steps;
+    uint64_t steps;
 
     /**
      * @brief number of memory operations
      */
-    unsigned int memops;
+    uint64_t memops;
 
     /**
      * @brief number of comparisons
      */
-    unsigned int comparisons;
+    uint64_t comparisons;
 
     Counter() : steps(0), memops(0), comparisons(0) {};
 
     void reset() {
-        steps = 0;
+        steps = memops = comparisons = 0;
     }
 
     /**
      * @brief Increase number of steps
      */
-    void step(unsigned int t = 1) {
+    void step(uint64_t t = 1) {
+#if NHF_COUNTERS
         steps += t;
+#endif
     }
 
     /**
      * @brief Increase number of memory operations.
      * General rule: every assignment counts as one!
      */
-    void mem(unsigned int t = 1) {
+    void mem(uint64_t t = 1) {
+#if NHF_COUNTERS
         memops += t;
+#endif
     }
 
     /**
      * @brief Increase number of comparisons (basically if statements).
      */
-    void comp(unsigned int t = 1) {
+    void comp(uint64_t t = 1) {
+#if NHF_COUNTERS
         comparisons += t;
+#endif
     }
 };
 
@@ -2,11 +2,14 @@
 #define GEO_H
 
 #include "consts.h"
+#include "mapped.h"
 #include "util.h"
 
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -18,8 +21,9 @@ static const float EARTH_RADIUS_M = 6367449.f;
 
 /**
  * Simple geospatial point
+ * Plain data (no virtual bases), so that the points of a map can be stored and copied as one array
  */
-struct Point : public Hashable, public Serializable {
+struct Point {
     /**
      * longitude, must be between -180..180
      */
@@ -36,15 +40,16 @@ struct Point : public Hashable, public Serializable {
     Point(float lon = 0.f, float lat = 0.f) : x(lat), y(lon) {};
 
     /**
-     * Hashing impl
+     * @brief Fixed-point location, both coordinates in 1e-7 degrees (the precision of OSM), packed into 64 bits
+     * Points of the same location have the same key, so coincident points can be found by exact comparison (eg. in a hash table), with no trig.
      */
-    size_t hash() const {
-        static const double precision = 1e8;
+    uint64_t key() const {
+        static const double precision = 1e7;
 
-        const std::size_t h1 = std::hash<int64_t>{}(std::round(x * precision));
-        const std::size_t h2 = std::hash<int64_t>{}(std::round(y * precision));
+        const uint32_t kx = static_cast<int32_t>(std::lround(x * precision));
+        const uint32_t ky = static_cast<int32_t>(std::lround(y * precision));
 
-        return h1 ^ (h2 << 1);
+        return static_cast<uint64_t>(kx) << 32 | ky;
     }
 
     /**
@@ -246,23 +251,127 @@ enum class HighwayType : int {
     proposed,
 };
 
+/**
+ * @brief A road's range of points, in the point array of the map it belongs to
+ * The range is kept as indices; the pointer to the array is bound once the array is complete (see `Roads`).
+ */
+class Coordinates {
+    const Point *base = nullptr;
+    uint32_t first = 0, count = 0;
+
+  public:
+    Coordinates() {}
+
+    Coordinates(uint32_t first, uint32_t count) : first(first), count(count) {}
+
+    const Point *begin() const {
+        return base + first;
+    }
+
+    const Point *end() const {
+        return base + first + count;
+    }
+
+    const Point &operator[](size_t i) const {
+        return base[first + i];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    /**
+     * @brief index of the first point in the array
+     */
+    uint32_t offset() const {
+        return first;
+    }
+
+    /**
+     * @brief move the range, after the array has been prepended with `by` points
+     */
+    void shift(uint32_t by) {
+        first += by;
+    }
+
+    void bind(const Point *points) {
+        base = points;
+    }
+};
+
+/**
+ * @brief A road's name or ref, a range in the character array of the map it belongs to
+ * Like `Coordinates`, kept as indices until `Roads` binds the array; the text is not null-terminated.
+ */
+class Text {
+    const char *base = nullptr;
+    uint32_t first = 0, count = 0;
+
+  public:
+    Text() {}
+
+    Text(uint32_t first, uint32_t count) : first(first), count(count) {}
+
+    const char *begin() const {
+        return base + first;
+    }
+
+    const char *end() const {
+        return base + first + count;
+    }
+
+    std::string str() const {
+        return std::string(begin(), end());
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    /**
+     * @brief index of the first character in the array
+     */
+    uint32_t offset() const {
+        return first;
+    }
+
+    /**
+     * @brief move the range, after the array has been prepended with `by` characters
+     */
+    void shift(uint32_t by) {
+        first += by;
+    }
+
+    void bind(const char *chars) {
+        base = chars;
+    }
+};
+
 /**
  * OSM properties of a road
  * For more information, see: https://wiki.openstreetmap.org/wiki/Key:<insert-member-name>
  */
-struct Road : public Serializable {
+struct Road {
     unsigned int id;
 
-    std::vector<Point *> coordinates;
+    Coordinates coordinates;
 
     std::string getname() const {
         if (name.empty() && ref.empty())
             return "unknown road";
 
         if (name.empty())
-            return ref;
+            return ref.str();
 
-        return name;
+        return name.str();
     }
 
     /**
@@ -273,12 +382,12 @@ struct Road : public Serializable {
     /**
      * Road name, if any
      */
-    std::string name;
+    Text name;
 
     /**
      * Road reference name (eg. a number or M0, M31 etc.)
      */
-    std::string ref;
+    Text ref;
 
     /**
      * Is the road a roundabout?
@@ -331,34 +440,152 @@ struct Road : public Serializable {
      */
     float visibility();
 
-    void write(std::ostream &os) const override;
+    /**
+     * Converts a line of geojson to a road object
+     * @param points the coordinates are appended here, the road refers to their range
+     * @param strings the name and the ref are appended here, the road refers to their ranges
+     */
+    void parse(const std::string &line, std::vector<Point> &points, std::vector<char> &strings);
+
+    /**
+     * Converts a line of geojson to a road object, in a single pass over [begin, end)
+     * @param points the coordinates are appended here, the road refers to their range
+     * @param strings the name and the ref are appended here, the road refers to their ranges
+     */
+    void parse(const char *begin, const char *end, std::vector<Point> &points, std::vector<char> &strings);
+};
+
+/**
+ * @brief The roads of a map
+ * Owns the roads in blocks (one per `append`), and the coordinates and the names of all of them in one contiguous array
+ * each (road after road), so none of them are allocated nor freed one by one.
+ * Roads loaded from the cache use the mapped file in place instead: the points and the names are its sections (see `map`).
+ */
+class Roads {
+    std::vector<Road *> roads;
+    std::vector<std::vector<Road>> blocks;
 
-    void read(std::istream &is) override;
+    std::vector<Point> points;
+    std::vector<char> strings;
 
     /**
-     * Converts a line of geojson to a road object
+     * @brief the cache file the roads were loaded from, kept open as long as the roads refer to it
      */
-    void parse(const std::string &line);
+    std::unique_ptr<MappedFile> file;
 
     /**
-     * Constructor
+     * @brief the arrays the roads are bound to, either `points` and `strings` or sections of `file`
      */
-    Road() {}
+    const Point *point_data = nullptr;
+    size_t point_size = 0;
+    const char *string_data = nullptr;
+
+    void bind(size_t from) {
+        for (size_t i = from; i < roads.size(); i++) {
+            roads[i]->coordinates.bind(point_data);
+            roads[i]->name.bind(string_data);
+            roads[i]->ref.bind(string_data);
+        }
+    }
+
+  public:
+    using const_iterator = std::vector<Road *>::const_iterator;
+
+    Roads() {}
+
+    Roads(const Roads &) = delete;
+    Roads &operator=(const Roads &) = delete;
+
+    // the buffers of the vectors and the mapping stay where they are, so the roads remain bound
+    Roads(Roads &&other)
+        : roads(std::move(other.roads)), blocks(std::move(other.blocks)), points(std::move(other.points)), strings(std::move(other.strings)), file(std::move(other.file)),
+          point_data(other.point_data), point_size(other.point_size), string_data(other.string_data) {}
+
+    void reserve(size_t road_count, size_t point_count, size_t string_count) {
+        roads.reserve(road_count);
+        points.reserve(point_count);
+        strings.reserve(string_count);
+    }
 
     /**
-     * Copy constructor
-     * Creates deep copy of all pointer types as well
+     * @brief Take over a block of roads along with the arrays their coordinates and names refer to
+     * @pre the roads were not loaded from a cache
      */
-    Road(const Road &other)
-        : id(other.id), highway(other.highway), name(other.name), ref(other.ref), roundabout(other.roundabout), oneway(other.oneway), bridge(other.bridge), maxspeed(other.maxspeed), lanes(other.lanes), toll(other.toll), lit(other.lit) {
-        coordinates.reserve(other.coordinates.size());
-        for (const auto *pt : other.coordinates)
-            coordinates.push_back(new Point(*pt)); // Deep copy
+    void append(std::vector<Road> &&block, std::vector<Point> &&other_points, std::vector<char> &&other_strings) {
+        const size_t first = roads.size();
+        const uint32_t point_shift = points.size(), string_shift = strings.size();
+
+        if (points.empty())
+            points.swap(other_points);
+        else
+            points.insert(points.end(), other_points.begin(), other_points.end());
+
+        if (strings.empty())
+            strings.swap(other_strings);
+        else
+            strings.insert(strings.end(), other_strings.begin(), other_strings.end());
+
+        blocks.push_back(std::move(block));
+        for (Road &road : blocks.back()) {
+            road.coordinates.shift(point_shift);
+            road.name.shift(string_shift);
+            road.ref.shift(string_shift);
+            roads.push_back(&road);
+        }
+
+        // rebind every road if an array has moved
+        const bool moved = points.data() != point_data || strings.data() != string_data;
+        point_data = points.data();
+        point_size = points.size();
+        string_data = strings.data();
+
+        bind(moved ? 0 : first);
+    }
+
+    /**
+     * @brief Take over the roads loaded from a mapped cache file, using its point and string sections in place
+     * @pre there are no roads yet
+     */
+    void map(std::unique_ptr<MappedFile> &&mapped, const Point *mapped_points, size_t mapped_point_count, const char *mapped_strings, std::vector<Road> &&block) {
+        file = std::move(mapped);
+        point_data = mapped_points;
+        point_size = mapped_point_count;
+        string_data = mapped_strings;
+
+        blocks.push_back(std::move(block));
+        for (Road &road : blocks.back())
+            roads.push_back(&road);
+
+        bind(0);
+    }
+
+    /**
+     * @brief every point of the map, road after road
+     */
+    Coordinates coordinates() const {
+        Coordinates all(0, point_size);
+        all.bind(point_data);
+        return all;
+    }
+
+    Road *operator[](size_t i) const {
+        return roads[i];
+    }
+
+    const_iterator begin() const {
+        return roads.begin();
+    }
+
+    const_iterator end() const {
+        return roads.end();
+    }
+
+    size_t size() const {
+        return roads.size();
     }
 
-    ~Road() {
-        for (Point *p : coordinates)
-            delete p;
+    bool empty() const {
+        return roads.empty();
     }
 };
 
@@ -369,11 +596,11 @@ struct Road : public Serializable {
  */
 struct Node {
     Road *road;
-    Point *loc;
+    const Point *loc;
 
-    Node(Road *road, Point *loc) : road(road), loc(loc) {};
+    Node(Road *road, const Point *loc) : road(road), loc(loc) {};
 
-    operator Point &() const {
+    operator const Point &() const {
         return *loc;
     }
 
@@ -397,11 +624,16 @@ std::ostream &operator<<(std::ostream &os, const Point &point);
  */
 std::istream &operator>>(std::istream &is, Point &point);
 std::istream &operator>>(std::istream &is, std::vector<Point> &points);
-std::istream &operator>>(std::istream &is, std::vector<Point *> &points);
 
 std::ostream &operator<<(std::ostream &os, const HighwayType &highway_type);
 std::istream &operator>>(std::istream &is, HighwayType &highway_type);
 
+/**
+ * Look up a highway type by its OSM name (case insensitive)
+ * @returns false if the name is not a known type, highway_type is left untouched then
+ */
+bool parse_highway(const char *begin, const char *end, HighwayType &highway_type);
+
 std::ostream &operator<<(std::ostream &os, const Road &road);
 std::ostream &operator<<(std::ostream &os, const BBox &bbox);
 
@@ -0,0 +1,309 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "diagnostics.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Priority queue implementation used by the searches
+ */
+enum class HeapType {
+    Lazy,
+    Dary,
+    Radix,
+};
+
+/**
+ * @brief Binary heap with lazy deletion
+ * Every push adds a new item, even if the vertex is already queued. Outdated items are left in the queue,
+ * the search has to skip them when they come up.
+ */
+class LazyHeap : Sizable {
+  public:
+    using Item = std::pair<float, int>;
+
+  private:
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> pq;
+
+  public:
+    LazyHeap(size_t vertices = 0) {}
+
+    size_t size_of() const override {
+        return sizeof(pq) + sizeof(std::vector<Item>) + sizeof(Item) * pq.size() * 2;
+    }
+
+    bool empty() const {
+        return pq.empty();
+    }
+
+    size_t size() const {
+        return pq.size();
+    }
+
+    const Item &top() const {
+        return pq.top();
+    }
+
+    void pop() {
+        pq.pop();
+    }
+
+    void push(float key, int v) {
+        pq.emplace(key, v);
+    }
+
+    void clear() {
+        pq = decltype(pq)();
+    }
+};
+
+/**
+ * @brief Addressable D-ary heap with decrease-key
+ * Every vertex is queued at most once. Its position in the heap array is kept up to date,
+ * so pushing an already queued vertex moves it in place instead of adding a duplicate.
+ * @note a higher arity makes the tree shallower (cheaper decrease-key), at the cost of more comparisons per pop
+ */
+template <unsigned int D = 4> class DaryHeap : Sizable {
+  public:
+    using Item = std::pair<float, int>;
+
+  private:
+    std::vector<Item> heap;
+
+    /**
+     * @brief index of each vertex in the heap array, -1 if it is not queued
+     */
+    std::vector<int> position;
+
+    void place(size_t i, const Item &item) {
+        heap[i] = item;
+        position[item.second] = i;
+    }
+
+    void sift_up(size_t i) {
+        const Item item = heap[i];
+
+        while (i > 0) {
+            const size_t parent = (i - 1) / D;
+            if (!(item < heap[parent]))
+                break;
+
+            place(i, heap[parent]);
+            i = parent;
+        }
+
+        place(i, item);
+    }
+
+    void sift_down(size_t i) {
+        const Item item = heap[i];
+
+        while (true) {
+            const size_t first = i * D + 1;
+            if (first >= heap.size())
+                break;
+
+            const size_t last = std::min(first + D, heap.size());
+
+            size_t best = first;
+            for (size_t c = first + 1; c < last; c++)
+                if (heap[c] < heap[best])
+                    best = c;
+
+            if (!(heap[best] < item))
+                break;
+
+            place(i, heap[best]);
+            i = best;
+        }
+
+        place(i, item);
+    }
+
+  public:
+    DaryHeap(size_t vertices) : position(vertices, -1) {}
+
+    size_t size_of() const override {
+        return true_size(heap) + true_size(position);
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    bool contains(int v) const {
+        return position[v] >= 0;
+    }
+
+    const Item &top() const {
+        return heap.front();
+    }
+
+    void pop() {
+        position[heap.front().second] = -1;
+
+        const Item last = heap.back();
+        heap.pop_back();
+
+        if (!heap.empty()) {
+            heap.front() = last;
+            sift_down(0);
+        }
+    }
+
+    /**
+     * @brief insert v, or move it to its new key if it is already queued
+     */
+    void push(float key, int v) {
+        if (position[v] < 0) {
+            heap.emplace_back(key, v);
+            sift_up(heap.size() - 1);
+            return;
+        }
+
+        const size_t i = position[v];
+        const float old = heap[i].first;
+        heap[i].first = key;
+
+        if (key < old)
+            sift_up(i);
+        else
+            sift_down(i);
+    }
+
+    void clear() {
+        for (const Item &item : heap)
+            position[item.second] = -1;
+
+        heap.clear();
+    }
+};
+
+/**
+ * @brief Monotone radix heap on the bit patterns of the keys
+ * The bits of a non-negative float, read as an unsigned integer, are ordered the same way as the float itself,
+ * so the keys are bucketed exactly as they are, without quantizing them. Bucket 0 holds the keys equal to the
+ * last popped one, bucket b the keys whose highest bit differing from it is bit b-1. When bucket 0 runs out,
+ * the first non-empty bucket is spread over the lower ones around its minimum: an item moves down at most
+ * 32 times over its life, so pushes and pops are amortized O(1) (O(32)), with no comparisons between items.
+ * @note only for monotone searches (Dijkstra), a key is never smaller than the last popped one;
+ * smaller keys (negative weights) are raised to it
+ */
+class RadixHeap : Sizable {
+  public:
+    using Item = std::pair<float, int>;
+
+  private:
+    static const int BUCKETS = 33;
+
+    std::vector<Item> buckets[BUCKETS];
+    size_t count = 0;
+
+    /**
+     * @brief the smallest key, as of the last spread, and its bits; keys are bucketed relative to it
+     */
+    float floor = 0.f;
+    uint32_t last = 0;
+
+    static uint32_t bits(float key) {
+        uint32_t b;
+        std::memcpy(&b, &key, sizeof(b));
+        return b;
+    }
+
+    int bucket(uint32_t key) const {
+        return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+    }
+
+    /**
+     * @brief move the minimum of the first non-empty bucket (and its equals) to bucket 0, spread the rest below
+     */
+    void refill() {
+        int b = 1;
+        while (buckets[b].empty())
+            b++;
+
+        std::vector<Item> &from = buckets[b];
+
+        Item min = from.front();
+        for (const Item &item : from)
+            if (bits(item.first) < bits(min.first))
+                min = item;
+
+        floor = min.first;
+        last = bits(floor);
+
+        for (const Item &item : from)
+            buckets[bucket(bits(item.first))].push_back(item);
+
+        from.clear();
+    }
+
+  public:
+    RadixHeap(size_t vertices = 0) {}
+
+    size_t size_of() const override {
+        size_t bytes = 0;
+        for (const std::vector<Item> &b : buckets)
+            bytes += true_size(b);
+
+        return bytes;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    /**
+     * @note not const: the buckets are spread when bucket 0 is empty
+     */
+    const Item &top() {
+        if (buckets[0].empty())
+            refill();
+
+        return buckets[0].back();
+    }
+
+    void pop() {
+        if (buckets[0].empty())
+            refill();
+
+        buckets[0].pop_back();
+        count--;
+    }
+
+    void push(float key, int v) {
+        if (!(key > floor))
+            key = floor;
+
+        buckets[bucket(bits(key))].emplace_back(key, v);
+        count++;
+    }
+
+    void clear() {
+        for (std::vector<Item> &b : buckets)
+            b.clear();
+
+        count = 0;
+        floor = 0.f;
+        last = 0;
+    }
+};
+
+#endif // HEAP_H
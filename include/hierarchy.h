@@ -0,0 +1,676 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include "algorithm.h"
+#include "cache.h"
+#include "consts.h"
+#include "diagnostics.h"
+#include "lib.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Contraction Hierarchy
+ * The vertices are contracted one by one, from the least important to the most important. Whenever a
+ * contracted vertex was the only shortest path between two of its neighbors, a shortcut edge is inserted.
+ * A query then only relaxes edges leading to more important vertices, from both ends.
+ * @note edge weights are taken without the previous vertex, so turn penalties are not part of the hierarchy
+ */
+template <typename T> class Hierarchy : public Serializable, Sizable {
+  public:
+    struct Arc {
+        int to;
+        float weight;
+
+        /**
+         * @brief the vertex this shortcut bypasses, -1 for the original edges
+         */
+        int middle;
+    };
+
+  private:
+    static const uint32_t MAGIC = 0x4843484e; // "NHCH"
+    static const uint32_t VERSION = 2;
+
+    /**
+     * @brief stop a witness search after settling this many vertices, or beyond this many arcs from its source (and insert the shortcut)
+     */
+    static const int WITNESS_LIMIT = 500;
+    static const int HOP_LIMIT = 8;
+
+    /**
+     * @brief the same limits while only simulating a contraction to rate a vertex, which happens far more often
+     */
+    static const int SIMULATION_LIMIT = 100;
+    static const int SIMULATION_HOPS = 3;
+
+    /**
+     * @brief a witness path this much longer (relatively) still counts, so that paths of equal length, summed in another
+     * order, don't differ by a rounding error and get a shortcut each
+     */
+    static constexpr float TOLERANCE = 1.000001f;
+
+    /**
+     * @brief contraction order of each vertex
+     */
+    std::vector<int> rank;
+
+    /**
+     * @brief arcs towards more important vertices, grouped by their source (CSR)
+     */
+    std::vector<int> up_offsets;
+    std::vector<Arc> up;
+
+    /**
+     * @brief reversed arcs coming from more important vertices, grouped by their target (CSR)
+     */
+    std::vector<int> down_offsets;
+    std::vector<Arc> down;
+
+    /**
+     * @brief number of edges in the original graph, used to detect stale files
+     */
+    uint64_t edges = 0;
+
+    /**
+     * @brief checksum of the edges and their weights, and the size and modification time of the map (see `cache::stamp`)
+     * the hierarchy was built of, used to detect stale files
+     */
+    uint64_t signature = 0;
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+
+    // --- preprocessing state
+
+    /**
+     * @brief arcs of the remaining graph; once a vertex is contracted its own lists are final (they only lead to more
+     * important vertices), and its arcs are dropped from the lists of its neighbors
+     */
+    std::vector<std::vector<Arc>> out, in;
+
+    /**
+     * @brief depth of each vertex in the hierarchy so far: one more than its deepest contracted neighbor
+     */
+    std::vector<int> level;
+
+    // witness search scratch space; `goal` marks the targets of the vertex being contracted with its index
+    std::vector<float> witness;
+    std::vector<int> hops;
+    std::vector<int> goal;
+    std::vector<int> touched;
+    std::vector<std::pair<float, int>> heap;
+
+    /**
+     * @brief add an edge to the dynamic graph, or lower the weight of the existing one
+     * @returns false, if an edge at least as good was already present
+     */
+    bool insert(int from, int to, float weight, int middle) {
+        for (Arc &a : out[from]) {
+            if (a.to != to)
+                continue;
+
+            if (a.weight <= weight)
+                return false;
+
+            a.weight = weight, a.middle = middle;
+            for (Arc &b : in[to])
+                if (b.to == from)
+                    b.weight = weight, b.middle = middle;
+
+            return true;
+        }
+
+        out[from].push_back({to, weight, middle});
+        in[to].push_back({from, weight, middle});
+        return true;
+    }
+
+    /**
+     * @brief limited Dijkstra from `source`, avoiding `skip`, until the `targets` marked as goals of `skip` are settled
+     * Only vertices settled for real count towards `settle_limit`, and the search doesn't go farther than `hop_limit` arcs.
+     */
+    void witness_search(int source, int skip, float limit, int targets, int settle_limit, int hop_limit) {
+        for (int v : touched)
+            witness[v] = FMAX;
+        touched.clear();
+        heap.clear();
+
+        const auto later = std::greater<std::pair<float, int>>();
+        limit *= TOLERANCE;
+
+        witness[source] = 0.f;
+        hops[source] = 0;
+        touched.push_back(source);
+        heap.emplace_back(0.f, source);
+
+        for (int settled = 0; !heap.empty() && settled < settle_limit && targets > 0;) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            const float d = heap.back().first;
+            const int current = heap.back().second;
+            heap.pop_back();
+
+            if (d > limit)
+                break;
+
+            if (d > witness[current])
+                continue;
+
+            settled++;
+            if (goal[current] == skip && current != source)
+                targets--;
+
+            if (hops[current] >= hop_limit)
+                continue;
+
+            for (const Arc &a : out[current]) {
+                if (a.to == skip || d + a.weight > limit)
+                    continue;
+
+                if (d + a.weight < witness[a.to]) {
+                    if (witness[a.to] == FMAX)
+                        touched.push_back(a.to);
+
+                    witness[a.to] = d + a.weight;
+                    hops[a.to] = hops[current] + 1;
+
+                    heap.emplace_back(d + a.weight, a.to);
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief find (and optionally insert) the shortcuts required to contract v
+     * Without `apply` the contraction is only simulated, with cheaper witness searches (see `SIMULATION_LIMIT`).
+     * @returns the number of shortcuts
+     */
+    int shortcuts(int v, bool apply) {
+        int count = 0;
+
+        for (const Arc &b : out[v])
+            goal[b.to] = v;
+
+        for (size_t i = 0; i < in[v].size(); i++) {
+            const Arc a = in[v][i];
+
+            float limit = 0.f;
+            int targets = 0;
+            for (const Arc &b : out[v]) {
+                if (b.to != a.to) {
+                    limit = std::max(limit, a.weight + b.weight);
+                    targets++;
+                }
+            }
+
+            // no other neighbor to reach through v
+            if (targets == 0)
+                continue;
+
+            witness_search(a.to, v, limit, targets, apply ? WITNESS_LIMIT : SIMULATION_LIMIT, apply ? HOP_LIMIT : SIMULATION_HOPS);
+
+            for (size_t j = 0; j < out[v].size(); j++) {
+                const Arc b = out[v][j];
+                if (b.to == a.to)
+                    continue;
+
+                if (witness[b.to] > (a.weight + b.weight) * TOLERANCE) {
+                    count++;
+
+                    if (apply)
+                        insert(a.to, b.to, a.weight + b.weight, v);
+                }
+            }
+        }
+
+        return count;
+    }
+
+    /**
+     * @brief edge difference heuristic: inserted shortcuts minus removed arcs, plus half the depth of the vertex
+     */
+    float priority(int v) {
+        const int removed = in[v].size() + out[v].size();
+
+        return shortcuts(v, false) - removed + level[v] / 2.f;
+    }
+
+    /**
+     * @brief drop the arcs of a contracted vertex from the lists of its neighbors
+     */
+    void detach(int v) {
+        auto drop = [v](std::vector<Arc> &arcs) {
+            for (size_t i = 0; i < arcs.size();) {
+                if (arcs[i].to == v) {
+                    arcs[i] = arcs.back();
+                    arcs.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        };
+
+        for (const Arc &a : out[v])
+            drop(in[a.to]);
+        for (const Arc &a : in[v])
+            drop(out[a.to]);
+    }
+
+    /**
+     * @brief pack the final lists of the contracted vertices into the upward and downward arrays
+     * The outgoing arcs of a vertex lead upward, its incoming ones come from above: they are the downward arcs as they are.
+     */
+    void freeze() {
+        const int n = rank.size();
+
+        up_offsets.assign(1, 0);
+        down_offsets.assign(1, 0);
+        up.clear();
+        down.clear();
+
+        for (int v = 0; v < n; v++) {
+            up.insert(up.end(), out[v].begin(), out[v].end());
+            down.insert(down.end(), in[v].begin(), in[v].end());
+
+            up_offsets.push_back(up.size());
+            down_offsets.push_back(down.size());
+        }
+
+        std::vector<std::vector<Arc>>().swap(out);
+        std::vector<std::vector<Arc>>().swap(in);
+        std::vector<int>().swap(level);
+        std::vector<float>().swap(witness);
+        std::vector<int>().swap(hops);
+        std::vector<int>().swap(goal);
+        std::vector<int>().swap(touched);
+        std::vector<std::pair<float, int>>().swap(heap);
+    }
+
+    /**
+     * @brief the arc between two adjacent vertices of the hierarchy, in original edge direction
+     */
+    const Arc *find(int from, int to) const {
+        if (rank[from] < rank[to]) {
+            for (const Arc &a : upward(from))
+                if (a.to == to)
+                    return &a;
+        } else {
+            for (const Arc &a : downward(to))
+                if (a.to == from)
+                    return &a;
+        }
+
+        return nullptr;
+    }
+
+  public:
+    /**
+     * @brief Range of arcs of a single vertex
+     */
+    struct Arcs {
+        const Arc *first, *last;
+
+        const Arc *begin() const {
+            return first;
+        }
+
+        const Arc *end() const {
+            return last;
+        }
+    };
+
+    size_t size_of() const override {
+        return true_size(rank) + true_size(up_offsets) + true_size(up) + true_size(down_offsets) + true_size(down);
+    }
+
+    size_t size() const {
+        return rank.size();
+    }
+
+    /**
+     * @brief arcs leaving v towards more important vertices (forward search)
+     */
+    Arcs upward(int v) const {
+        return {up.data() + up_offsets[v], up.data() + up_offsets[v + 1]};
+    }
+
+    /**
+     * @brief arcs entering v from more important vertices, reversed (backward search)
+     */
+    Arcs downward(int v) const {
+        return {down.data() + down_offsets[v], down.data() + down_offsets[v + 1]};
+    }
+
+    /**
+     * @brief checks if this hierarchy was built for the given graph and weights, of the current version of the map
+     * @note if the map itself is missing, only the graph and the weights are checked
+     */
+    bool matches(const DiGraph<T> &graph, const Weight<T> &weight, const std::string &map) const {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+
+        if (rank.size() != graph.size() || edges != graph.edge_count())
+            return false;
+
+        if (cache::stamp(map, size, mtime) && (size != source_size || mtime != source_mtime))
+            return false;
+
+        return signature == fingerprint(graph, weight);
+    }
+
+    /**
+     * @brief contract the graph, using static edge weights
+     * @param map the map the graph was made of, its stamp is stored with the hierarchy
+     */
+    void build(const DiGraph<T> &graph, const Weight<T> &weight, const std::string &map) {
+        const int n = graph.size();
+
+        out.assign(n, {});
+        in.assign(n, {});
+        level.assign(n, 0);
+        witness.assign(n, FMAX);
+        hops.assign(n, 0);
+        goal.assign(n, -1);
+        rank.assign(n, -1);
+
+        edges = graph.edge_count();
+        signature = fingerprint(graph, weight);
+
+        source_size = 0;
+        source_mtime = 0;
+        cache::stamp(map, source_size, source_mtime);
+
+        for (int u = 0; u < n; u++)
+            for (int v : graph.neighbors(u))
+                if (u != v)
+                    insert(u, v, weight.get(u, v, -1, graph), -1);
+
+        // the priority each vertex was last pushed with, older entries are skipped
+        std::vector<float> current(n);
+
+        using PQitem = std::pair<float, int>;
+        std::priority_queue<PQitem, std::vector<PQitem>, std::greater<PQitem>> order;
+
+        for (int v = 0; v < n; v++) {
+            current[v] = priority(v);
+            order.emplace(current[v], v);
+        }
+
+        std::vector<int> neighbors;
+
+        int next_rank = 0;
+        while (!order.empty()) {
+            const int v = order.top().second;
+            const float p = order.top().first;
+            order.pop();
+
+            if (rank[v] >= 0 || p != current[v])
+                continue;
+
+            shortcuts(v, true);
+            detach(v);
+            rank[v] = next_rank++;
+
+            // only the priorities of the neighbors change
+            neighbors.clear();
+            for (const Arc &a : in[v])
+                neighbors.push_back(a.to);
+            for (const Arc &a : out[v])
+                neighbors.push_back(a.to);
+
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+            for (int u : neighbors) {
+                level[u] = std::max(level[u], level[v] + 1);
+
+                current[u] = priority(u);
+                order.emplace(current[u], u);
+            }
+        }
+
+        freeze();
+    }
+
+    /**
+     * @brief expand the arc from -> to into original vertices, appended to the path (`from` excluded)
+     */
+    void unpack(int from, int to, std::vector<int> &path) const {
+        std::vector<std::pair<int, int>> stack = {{from, to}};
+
+        while (!stack.empty()) {
+            const std::pair<int, int> e = stack.back();
+            stack.pop_back();
+
+            const Arc *arc = find(e.first, e.second);
+            if (arc == nullptr || arc->middle < 0) {
+                path.push_back(e.second);
+                continue;
+            }
+
+            stack.emplace_back(arc->middle, e.second);
+            stack.emplace_back(e.first, arc->middle);
+        }
+    }
+
+    void write(std::ostream &os) const override {
+        const uint32_t magic = MAGIC, version = VERSION;
+        os.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+        os.write(reinterpret_cast<const char *>(&version), sizeof(version));
+        os.write(reinterpret_cast<const char *>(&edges), sizeof(edges));
+        os.write(reinterpret_cast<const char *>(&signature), sizeof(signature));
+        os.write(reinterpret_cast<const char *>(&source_size), sizeof(source_size));
+        os.write(reinterpret_cast<const char *>(&source_mtime), sizeof(source_mtime));
+
+        write_pod(os, rank);
+        write_pod(os, up_offsets);
+        write_pod(os, up);
+        write_pod(os, down_offsets);
+        write_pod(os, down);
+    }
+
+    /**
+     * @note on a foreign file the hierarchy is left empty, so that `matches` fails
+     */
+    void read(std::istream &is) override {
+        uint32_t magic = 0, version = 0;
+        is.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        is.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+        if (magic != MAGIC || version != VERSION) {
+            rank.clear();
+            return;
+        }
+
+        is.read(reinterpret_cast<char *>(&edges), sizeof(edges));
+        is.read(reinterpret_cast<char *>(&signature), sizeof(signature));
+        is.read(reinterpret_cast<char *>(&source_size), sizeof(source_size));
+        is.read(reinterpret_cast<char *>(&source_mtime), sizeof(source_mtime));
+
+        read_pod(is, rank);
+        read_pod(is, up_offsets);
+        read_pod(is, up);
+        read_pod(is, down_offsets);
+        read_pod(is, down);
+
+        if (!is || up_offsets.size() != rank.size() + 1 || down_offsets.size() != rank.size() + 1)
+            rank.clear();
+    }
+};
+
+/**
+ * @brief Contraction Hierarchy query: bidirectional Dijkstra on the upward arcs
+ * The found path is unpacked into original vertices, so `reconstruct` works like with the other algorithms.
+ */
+template <typename T> class CH : public Algorithm<T> {
+    const Hierarchy<T> &hierarchy;
+
+    // the forward side uses this->space
+    Workspace backward;
+    LazyHeap pq_f, pq_b;
+
+    int meeting = -1;
+    float best = FMAX;
+
+    void expand(bool forward) {
+        LazyHeap &pq = forward ? pq_f : pq_b;
+        Workspace &space = forward ? this->space : backward, &other = forward ? backward : this->space;
+
+        const float d = pq.top().first;
+        const int current = pq.top().second;
+        pq.pop();
+        this->mem(2);
+
+        this->comp();
+        if (d > space.distance(current))
+            return;
+
+        this->trace.parent(current);
+
+        for (const auto &arc : forward ? hierarchy.upward(current) : hierarchy.downward(current)) {
+            this->trace.child(arc.to);
+            this->step();
+
+            this->comp();
+            if (d + arc.weight < space.distance(arc.to)) {
+                space.set(arc.to, d + arc.weight, current);
+
+                pq.push(d + arc.weight, arc.to);
+                this->mem(3);
+            }
+
+            this->comp();
+            if (other.distance(arc.to) < FMAX && space.distance(arc.to) + other.distance(arc.to) < best) {
+                best = space.distance(arc.to) + other.distance(arc.to);
+                meeting = arc.to;
+                this->mem(2);
+            }
+        }
+    }
+
+    /**
+     * @brief expand the two sides from the seeded queues
+     */
+    void alternate(bool break_on_found) {
+        while (!pq_f.empty() || !pq_b.empty()) {
+            // the upward searches can't meet on a shorter path once their smallest keys reach the best one
+            this->comp(2);
+            if (break_on_found && (pq_f.empty() || pq_f.top().first >= best) && (pq_b.empty() || pq_b.top().first >= best))
+                break;
+
+            this->comp();
+            expand(pq_b.empty() || (!pq_f.empty() && pq_f.top().first <= pq_b.top().first));
+        }
+    }
+
+  public:
+    CH(const DiGraph<T> &graph, const Hierarchy<T> &hierarchy)
+        : Algorithm<T>(graph), hierarchy(hierarchy), //
+          backward(graph.size()), pq_f(graph.size()), pq_b(graph.size()) {
+        this->mem(graph.size() * 3);
+    }
+
+    size_t size_of() const override {
+        return Algorithm<T>::size_of() + hierarchy.size_of() + backward.size_of() + pq_f.size_of() + pq_b.size_of();
+    }
+
+    void run(int source, int target, bool break_on_found = false) override {
+        this->begin();
+        backward.reset();
+        pq_f.clear();
+        pq_b.clear();
+        meeting = -1;
+        best = FMAX;
+
+        this->space.set(source, 0.f, -1);
+        backward.set(target, 0.f, -1);
+        pq_f.push(0.f, source);
+        pq_b.push(0.f, target);
+        this->mem(4);
+
+        if (source == target) {
+            best = 0.f;
+            meeting = source;
+        }
+
+        alternate(break_on_found);
+    }
+
+    std::pair<int, int> seeded(const std::vector<typename Algorithm<T>::Seed> &sources, const std::vector<typename Algorithm<T>::Seed> &targets,
+                               bool break_on_found = false) override {
+        this->begin();
+        backward.reset();
+        pq_f.clear();
+        pq_b.clear();
+        meeting = -1;
+        best = FMAX;
+
+        for (const auto &s : sources) {
+            this->comp();
+            if (s.distance < this->space.distance(s.vertex)) {
+                this->space.set(s.vertex, s.distance, -1);
+                pq_f.push(s.distance, s.vertex);
+                this->mem(3);
+            }
+        }
+
+        for (const auto &t : targets) {
+            this->comp();
+            if (t.distance < backward.distance(t.vertex)) {
+                backward.set(t.vertex, t.distance, -1);
+                pq_b.push(t.distance, t.vertex);
+                this->mem(3);
+            }
+
+            // a vertex that is a source and a target at once
+            this->comp();
+            if (this->space.distance(t.vertex) < FMAX && this->space.distance(t.vertex) + backward.distance(t.vertex) < best) {
+                best = this->space.distance(t.vertex) + backward.distance(t.vertex);
+                meeting = t.vertex;
+            }
+        }
+
+        alternate(break_on_found);
+
+        if (meeting < 0)
+            return {-1, -1};
+
+        return {this->root(this->space, sources, meeting), this->root(backward, targets, meeting)};
+    }
+
+    /**
+     * @brief join the two upward paths at the meeting point and unpack the shortcuts on them
+     */
+    std::vector<int> reconstruct(int source, int target) const override {
+        std::vector<int> path;
+
+        if (meeting < 0) {
+            std::cerr << "No route to point\n";
+            return path;
+        }
+
+        std::vector<int> corners;
+        for (int u = meeting; u >= 0 && u != source; u = this->space.parent(u))
+            corners.push_back(u);
+        corners.push_back(source);
+        std::reverse(corners.begin(), corners.end());
+
+        for (int u = meeting; u != target && backward.parent(u) >= 0; u = backward.parent(u))
+            corners.push_back(backward.parent(u));
+
+        path.push_back(source);
+        for (size_t i = 1; i < corners.size(); i++)
+            hierarchy.unpack(corners[i - 1], corners[i], path);
+
+        return path;
+    }
+};
+
+#endif // HIERARCHY_H
@@ -0,0 +1,263 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include "algorithm.h"
+#include "cache.h"
+#include "consts.h"
+#include "diagnostics.h"
+#include "lib.h"
+#include "util.h"
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <vector>
+
+/**
+ * @brief ALT heuristic (A*, landmarks, triangle inequality)
+ * The distances from and to a handful of landmark vertices are precomputed. By the triangle inequality,
+ * d(L, t) - d(L, v) and d(v, L) - d(t, L) are both lower bounds of d(v, t), the best one is the estimate.
+ * @note the distances are taken without turn penalties, which can only make a route longer, so the
+ * estimate stays admissible for weights that add them.
+ */
+template <typename T> class Landmarks final : public Weight<T>, public Serializable, Sizable {
+    static const uint32_t MAGIC = 0x544c414e; // "NALT"
+    static const uint32_t VERSION = 2;
+
+    /**
+     * @brief the landmark vertices
+     */
+    std::vector<int> ids;
+
+    /**
+     * @brief d(landmark, v), vertex-major: the distances of v start at [v * ids.size()]
+     */
+    std::vector<float> from;
+
+    /**
+     * @brief d(v, landmark), vertex-major
+     */
+    std::vector<float> to;
+
+    /**
+     * @brief number of edges in the original graph, used to detect stale files
+     */
+    uint64_t edges = 0;
+
+    /**
+     * @brief checksum of the edges and their weights, and the size and modification time of the map (see `cache::stamp`)
+     * the distances were computed of, used to detect stale files
+     */
+    uint64_t signature = 0;
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+
+    /**
+     * @brief number of landmarks asked for (tiny graphs might have fewer far apart vertices)
+     */
+    uint64_t requested = 0;
+
+    /**
+     * @brief one-to-all Dijkstra with static weights
+     * @param backward run on the incoming edges, which gives the distances *to* the source
+     */
+    static void sweep(const DiGraph<T> &graph, const Transpose &incoming, const Weight<T> &weight, int source, bool backward, std::vector<float> &distance) {
+        using PQitem = std::pair<float, int>;
+        std::priority_queue<PQitem, std::vector<PQitem>, std::greater<PQitem>> pq;
+
+        distance.assign(graph.size(), FMAX);
+        distance[source] = 0.f;
+        pq.emplace(0.f, source);
+
+        while (!pq.empty()) {
+            const float d = pq.top().first;
+            const int current = pq.top().second;
+            pq.pop();
+
+            if (d > distance[current])
+                continue;
+
+            for (int neighbor : backward ? incoming.neighbors(current) : graph.neighbors(current)) {
+                const float w = backward ? weight.get(neighbor, current, -1, graph) : weight.get(current, neighbor, -1, graph);
+
+                if (d + w < distance[neighbor]) {
+                    distance[neighbor] = d + w;
+                    pq.emplace(d + w, neighbor);
+                }
+            }
+        }
+    }
+
+  public:
+    using Weight<T>::get;
+
+    /**
+     * @brief vertices are not known by their data alone, the trivial bound is the best we can do
+     */
+    float get(const T &, const T &, const T *prev = nullptr) const override {
+        return 0.f;
+    }
+
+    /**
+     * @brief lower bound of the distance from v to target
+     */
+    float get(int v, int target, int prev, const DiGraph<T> &graph) const override {
+        const size_t count = ids.size();
+        const float *from_v = from.data() + v * count, *from_t = from.data() + target * count;
+        const float *to_v = to.data() + v * count, *to_t = to.data() + target * count;
+
+        float estimate = 0.f;
+        for (size_t i = 0; i < count; i++) {
+            if (from_v[i] < FMAX && from_t[i] < FMAX)
+                estimate = std::max(estimate, from_t[i] - from_v[i]);
+
+            if (to_v[i] < FMAX && to_t[i] < FMAX)
+                estimate = std::max(estimate, to_v[i] - to_t[i]);
+        }
+
+        return estimate;
+    }
+
+    size_t size_of() const override {
+        return true_size(ids) + true_size(from) + true_size(to);
+    }
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    /**
+     * @brief checks if these landmarks were computed for the given graph and weights, of the current version of the map
+     * @note if the map itself is missing, only the graph and the weights are checked
+     */
+    bool matches(const DiGraph<T> &graph, const Weight<T> &weight, const std::string &map, size_t count) const {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+
+        if (requested != count || from.size() != graph.size() * ids.size() || edges != graph.edge_count())
+            return false;
+
+        if (cache::stamp(map, size, mtime) && (size != source_size || mtime != source_mtime))
+            return false;
+
+        return signature == fingerprint(graph, weight);
+    }
+
+    /**
+     * @brief pick landmarks with the farthest heuristic, and compute their distances
+     * The first landmark is the vertex farthest from the first vertex with edges, each next one is the vertex farthest from all chosen so far.
+     * @param map the map the graph was made of, its stamp is stored with the distances
+     */
+    void build(const DiGraph<T> &graph, const Weight<T> &weight, const std::string &map, size_t count) {
+        const size_t n = graph.size();
+        const Transpose incoming(graph);
+
+        ids.clear();
+        from.assign(n * count, FMAX);
+        to.assign(n * count, FMAX);
+        edges = graph.edge_count();
+        requested = count;
+        signature = fingerprint(graph, weight);
+
+        source_size = 0;
+        source_mtime = 0;
+        cache::stamp(map, source_size, source_mtime);
+
+        if (n == 0)
+            return;
+
+        // start from a vertex with edges, isolated ones (e.g. chain interiors of a compressed graph) reach nothing
+        int start = 0;
+        while (start + 1 < (int)n && !(graph.neighbors(start).begin() != graph.neighbors(start).end()))
+            start++;
+
+        std::vector<float> distance, nearest;
+        sweep(graph, incoming, weight, start, false, nearest);
+
+        while (ids.size() < count) {
+            // the farthest (reachable) vertex from the chosen landmarks
+            int landmark = -1;
+            for (size_t v = 0; v < n; v++)
+                if (nearest[v] < FMAX && (landmark < 0 || nearest[v] > nearest[landmark]))
+                    landmark = v;
+
+            if (landmark < 0 || (!ids.empty() && nearest[landmark] == 0.f))
+                break;
+
+            const size_t i = ids.size();
+            ids.push_back(landmark);
+
+            sweep(graph, incoming, weight, landmark, false, distance);
+            for (size_t v = 0; v < n; v++)
+                from[v * count + i] = distance[v];
+
+            if (i == 0)
+                nearest = distance;
+            else
+                for (size_t v = 0; v < n; v++)
+                    nearest[v] = std::min(nearest[v], distance[v]);
+
+            sweep(graph, incoming, weight, landmark, true, distance);
+            for (size_t v = 0; v < n; v++)
+                to[v * count + i] = distance[v];
+        }
+
+        // fewer landmarks were found (tiny graph): repack the arrays
+        if (ids.size() < count) {
+            std::vector<float> packed_from(n * ids.size()), packed_to(n * ids.size());
+            for (size_t v = 0; v < n; v++) {
+                for (size_t i = 0; i < ids.size(); i++) {
+                    packed_from[v * ids.size() + i] = from[v * count + i];
+                    packed_to[v * ids.size() + i] = to[v * count + i];
+                }
+            }
+
+            from.swap(packed_from);
+            to.swap(packed_to);
+        }
+    }
+
+    void write(std::ostream &os) const override {
+        const uint32_t magic = MAGIC, version = VERSION;
+        os.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+        os.write(reinterpret_cast<const char *>(&version), sizeof(version));
+        os.write(reinterpret_cast<const char *>(&edges), sizeof(edges));
+        os.write(reinterpret_cast<const char *>(&requested), sizeof(requested));
+        os.write(reinterpret_cast<const char *>(&signature), sizeof(signature));
+        os.write(reinterpret_cast<const char *>(&source_size), sizeof(source_size));
+        os.write(reinterpret_cast<const char *>(&source_mtime), sizeof(source_mtime));
+
+        write_pod(os, ids);
+        write_pod(os, from);
+        write_pod(os, to);
+    }
+
+    /**
+     * @note on a foreign file the landmarks are left empty, so that `matches` fails
+     */
+    void read(std::istream &is) override {
+        uint32_t magic = 0, version = 0;
+        is.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        is.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+        if (magic != MAGIC || version != VERSION) {
+            ids.clear();
+            return;
+        }
+
+        is.read(reinterpret_cast<char *>(&edges), sizeof(edges));
+        is.read(reinterpret_cast<char *>(&requested), sizeof(requested));
+        is.read(reinterpret_cast<char *>(&signature), sizeof(signature));
+        is.read(reinterpret_cast<char *>(&source_size), sizeof(source_size));
+        is.read(reinterpret_cast<char *>(&source_mtime), sizeof(source_mtime));
+
+        read_pod(is, ids);
+        read_pod(is, from);
+        read_pod(is, to);
+
+        if (!is || from.size() != to.size())
+            requested = 0;
+    }
+};
+
+#endif // LANDMARKS_H
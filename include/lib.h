@@ -6,7 +6,6 @@
 
 #include <algorithm>
 #include <stdexcept>
-#include <unordered_set>
 #include <vector>
 
 template <typename T> struct Vertex {
@@ -34,6 +33,53 @@ template <typename T> struct hash<Vertex<T>> {
 
 }; // namespace std
 
+/**
+ * Non-owning view over the neighbors of a vertex, iterating it does not allocate.
+ * Negative entries are skipped, so a matrix row can be exposed directly.
+ */
+class Neighbors {
+    const int *first, *last;
+
+  public:
+    class iterator {
+        const int *it, *last;
+
+        void skip() {
+            while (it != last && *it < 0)
+                ++it;
+        }
+
+      public:
+        iterator(const int *it, const int *last) : it(it), last(last) {
+            skip();
+        }
+
+        int operator*() const {
+            return *it;
+        }
+
+        iterator &operator++() {
+            ++it;
+            skip();
+            return *this;
+        }
+
+        bool operator!=(const iterator &rhs) const {
+            return it != rhs.it;
+        }
+    };
+
+    Neighbors(const int *first = nullptr, const int *last = nullptr) : first(first), last(last) {};
+
+    iterator begin() const {
+        return iterator(first, last);
+    }
+
+    iterator end() const {
+        return iterator(last, last);
+    }
+};
+
 /**
  * Abstract class for providing a backend for graph representation
  */
@@ -75,11 +121,24 @@ template <typename T> class GraphRepresentation : virtual Sizable {
         return vtx >= 0 && vtx < vertices.size();
     }
 
+    /**
+     * Get the neighbors of v, without copying them
+     * @returns a view, valid until the next edge is added
+     */
+    virtual Neighbors neighbors(int idx) const = 0;
+
     /**
      * Get the neighbors of v
      * @returns list of vertices
      */
-    virtual std::vector<int> adjacent(int idx) const = 0;
+    std::vector<int> adjacent(int idx) const {
+        std::vector<int> result;
+
+        for (int v : neighbors(idx))
+            result.push_back(v);
+
+        return result;
+    }
 
     /**
      * Add an edge to the graph
@@ -93,6 +152,24 @@ template <typename T> class GraphRepresentation : virtual Sizable {
      */
     virtual GraphRepresentation &b_edge(int a, int b) = 0;
 
+    /**
+     * Called once all the edges have been added.
+     * Backends may use this to compact their storage.
+     */
+    virtual void freeze() {}
+
+    /**
+     * Add every edge of an adjacency in compressed sparse row form, then freeze
+     * @param offsets N+1 long, the neighbors of v are targets[offsets[v]..offsets[v+1])
+     */
+    virtual void assign(const std::vector<int> &offsets, const std::vector<int> &targets) {
+        for (size_t v = 0; v + 1 < offsets.size(); v++)
+            for (int i = offsets[v]; i < offsets[v + 1]; i++)
+                edge(v, targets[i]);
+
+        freeze();
+    }
+
     virtual ~GraphRepresentation() {};
 };
 
@@ -124,14 +201,8 @@ template <typename T> class MGraph : public GraphRepresentation<T>, virtual Siza
         return GraphRepresentation<T>::size_of() + sizeof(int) * vertices.size() * vertices.size();
     }
 
-    std::vector<int> adjacent(int vtx) const override {
-        std::vector<int> neighbors;
-
-        for (size_t i = 0; i < vertices.size(); i++)
-            if (matrix[vtx][i] >= 0)
-                neighbors.push_back(matrix[vtx][i]);
-
-        return neighbors;
+    Neighbors neighbors(int vtx) const override {
+        return Neighbors(matrix[vtx], matrix[vtx] + vertices.size());
     }
 
     MGraph &edge(int from, int to) override {
@@ -161,11 +232,11 @@ template <typename T> class LGraph : public GraphRepresentation<T>, virtual Siza
     /**
      * An N long list
      */
-    std::unordered_set<int> *edges;
+    std::vector<int> *edges;
 
   public:
     LGraph(std::vector<Vertex<T>> vlist) : GraphRepresentation<T>(vlist) {
-        edges = new std::unordered_set<int>[vlist.size()];
+        edges = new std::vector<int>[vlist.size()];
     };
 
     size_t size_of() const override {
@@ -177,18 +248,17 @@ template <typename T> class LGraph : public GraphRepresentation<T>, virtual Siza
         return GraphRepresentation<T>::size_of() + set_size;
     }
 
-    std::vector<int> adjacent(int v) const override {
-        std::vector<int> neighbors;
-
-        for (int r : edges[v]) {
-            neighbors.push_back(r);
-        }
-
-        return neighbors;
+    Neighbors neighbors(int v) const override {
+        return Neighbors(edges[v].data(), edges[v].data() + edges[v].size());
     }
 
+    /**
+     * @note degrees are small on road networks, a linear search for duplicates is cheaper than hashing
+     */
     LGraph &edge(int from, int to) override {
-        edges[from].insert(to);
+        if (std::find(edges[from].begin(), edges[from].end(), to) == edges[from].end())
+            edges[from].push_back(to);
+
         return *this;
     }
 
@@ -201,11 +271,107 @@ template <typename T> class LGraph : public GraphRepresentation<T>, virtual Siza
     };
 };
 
+/**
+ * Compressed sparse row representation
+ * Edges are staged while the graph is being built, then frozen into two contiguous arrays.
+ */
+template <typename T> class CGraph : public GraphRepresentation<T>, virtual Sizable {
+    using GraphRepresentation<T>::vertices;
+
+    /**
+     * N+1 long, the neighbors of v are targets[offsets[v]..offsets[v+1])
+     */
+    std::vector<int> offsets;
+
+    /**
+     * E long, the edge targets grouped by their source vertex
+     */
+    std::vector<int> targets;
+
+    /**
+     * Edges added since the last freeze
+     */
+    std::vector<std::pair<int, int>> staged;
+
+  public:
+    CGraph(std::vector<Vertex<T>> vlist) : GraphRepresentation<T>(vlist), offsets(vlist.size() + 1, 0) {};
+
+    size_t size_of() const override {
+        return GraphRepresentation<T>::size_of() + true_size(offsets) + true_size(targets) + true_size(staged);
+    }
+
+    Neighbors neighbors(int v) const override {
+        return Neighbors(targets.data() + offsets[v], targets.data() + offsets[v + 1]);
+    }
+
+    CGraph &edge(int from, int to) override {
+        staged.emplace_back(from, to);
+        return *this;
+    }
+
+    CGraph &b_edge(int from, int to) override {
+        return edge(from, to).edge(to, from);
+    }
+
+    /**
+     * Merge the staged edges into the offset/target arrays (counting sort by source, duplicates removed)
+     */
+    void freeze() override {
+        if (staged.empty())
+            return;
+
+        // keep the edges of a previous freeze
+        for (size_t v = 0; v < vertices.size(); v++)
+            for (int i = offsets[v]; i < offsets[v + 1]; i++)
+                staged.emplace_back(v, targets[i]);
+
+        std::vector<int> count(vertices.size() + 1, 0);
+        for (const auto &e : staged)
+            count[e.first + 1]++;
+
+        for (size_t v = 0; v < vertices.size(); v++)
+            count[v + 1] += count[v];
+
+        std::vector<int> grouped(staged.size());
+        std::vector<int> cursor(count.begin(), count.end() - 1);
+        for (const auto &e : staged)
+            grouped[cursor[e.first]++] = e.second;
+
+        // sort and deduplicate each row in place, compacting as we go
+        int write = 0;
+        for (size_t v = 0; v < vertices.size(); v++) {
+            const auto first = grouped.begin() + count[v], last = grouped.begin() + count[v + 1];
+            std::sort(first, last);
+
+            offsets[v] = write;
+            for (auto it = first; it != last; ++it)
+                if (it == first || *it != *(it - 1))
+                    grouped[write++] = *it;
+        }
+
+        offsets[vertices.size()] = write;
+        grouped.resize(write);
+        grouped.shrink_to_fit();
+
+        targets.swap(grouped);
+        std::vector<std::pair<int, int>>().swap(staged);
+    }
+
+    /**
+     * @note the rows are taken as they are, they are expected to be sorted and free of duplicates
+     */
+    void assign(const std::vector<int> &offsets, const std::vector<int> &targets) override {
+        this->offsets = offsets;
+        this->targets = targets;
+        std::vector<std::pair<int, int>>().swap(staged);
+    }
+};
+
 // ----
 
 template <typename T> class DiGraph : Sizable {
   public:
-    enum class Driver { Matrix, List };
+    enum class Driver { Matrix, List, CSR };
     Driver driver;
 
   private:
@@ -222,11 +388,22 @@ template <typename T> class DiGraph : Sizable {
             G = new LGraph<T>(vlist);
             break;
 
+        case Driver::CSR:
+            G = new CGraph<T>(vlist);
+            break;
+
         default:
             throw std::invalid_argument("invalid graph driver!");
         }
     }
 
+    DiGraph(const DiGraph &) = delete;
+    DiGraph &operator=(const DiGraph &) = delete;
+
+    DiGraph(DiGraph &&other) : driver(other.driver), G(other.G) {
+        other.G = nullptr;
+    }
+
     size_t size_of() const override {
         return G->size_of();
     }
@@ -243,6 +420,19 @@ template <typename T> class DiGraph : Sizable {
         return G->vtx().size();
     }
 
+    /**
+     * @returns number of edges, not counting self-loops
+     */
+    size_t edge_count() const {
+        size_t count = 0;
+
+        for (size_t u = 0; u < size(); u++)
+            for (int v : neighbors(u))
+                count += (v != (int)u);
+
+        return count;
+    }
+
     const T &at(unsigned int idx) const {
         return G->vtx()[idx].data;
     }
@@ -255,6 +445,10 @@ template <typename T> class DiGraph : Sizable {
         return G->adjacent(v);
     }
 
+    Neighbors neighbors(int v) const {
+        return G->neighbors(v);
+    }
+
     DiGraph &edge(int from, int to) {
         G->edge(from, to);
         return *this;
@@ -265,9 +459,133 @@ template <typename T> class DiGraph : Sizable {
         return *this;
     }
 
+    /**
+     * @brief Signal the end of construction, see GraphRepresentation::freeze
+     */
+    DiGraph &freeze() {
+        G->freeze();
+        return *this;
+    }
+
+    /**
+     * @brief Replace the edges with a prebuilt adjacency, see GraphRepresentation::assign
+     */
+    DiGraph &assign(const std::vector<int> &offsets, const std::vector<int> &targets) {
+        G->assign(offsets, targets);
+        return *this;
+    }
+
     ~DiGraph() {
         delete G;
     }
 };
 
+/**
+ * Incoming edges of a DiGraph in compressed sparse row form.
+ * Used by searches that run backwards from the target.
+ */
+class Transpose : Sizable {
+    /**
+     * N+1 long, the predecessors of v are sources[offsets[v]..offsets[v+1])
+     */
+    std::vector<int> offsets;
+
+    /**
+     * E long, the edge sources grouped by their target vertex
+     */
+    std::vector<int> sources;
+
+  public:
+    template <typename T> Transpose(const DiGraph<T> &graph) : offsets(graph.size() + 1, 0) {
+        for (size_t v = 0; v < graph.size(); v++)
+            for (int to : graph.neighbors(v))
+                offsets[to + 1]++;
+
+        for (size_t v = 0; v < graph.size(); v++)
+            offsets[v + 1] += offsets[v];
+
+        sources.resize(offsets.back());
+
+        std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t v = 0; v < graph.size(); v++)
+            for (int to : graph.neighbors(v))
+                sources[cursor[to]++] = v;
+    }
+
+    size_t size_of() const override {
+        return true_size(offsets) + true_size(sources);
+    }
+
+    /**
+     * @returns the vertices with an edge pointing to v
+     */
+    Neighbors neighbors(int v) const {
+        return Neighbors(sources.data() + offsets[v], sources.data() + offsets[v + 1]);
+    }
+};
+
+/**
+ * Values attached to the edges of a DiGraph.
+ * The edges are numbered row by row, in the order the graph lists the neighbors (as in compressed sparse row form),
+ * an edge is looked up by scanning the row of its source.
+ */
+template <typename E> class EdgeMap : Sizable {
+    std::vector<int> offsets, targets;
+    std::vector<E> values;
+
+  public:
+    EdgeMap() {}
+
+    template <typename T> EdgeMap(const DiGraph<T> &graph, const E &fill = E()) : offsets(1, 0) {
+        for (size_t v = 0; v < graph.size(); v++) {
+            for (int to : graph.neighbors(v))
+                targets.push_back(to);
+
+            offsets.push_back(targets.size());
+        }
+
+        values.assign(targets.size(), fill);
+    }
+
+    /**
+     * @param offsets, targets the adjacency of the graph, see GraphRepresentation::assign
+     * @param values one per edge, in the order of the targets
+     */
+    EdgeMap(const std::vector<int> &offsets, const std::vector<int> &targets, const std::vector<E> &values) : offsets(offsets), targets(targets), values(values) {}
+
+    size_t size_of() const override {
+        return true_size(offsets) + true_size(targets) + true_size(values);
+    }
+
+    /**
+     * @returns number of edges
+     */
+    size_t size() const {
+        return values.size();
+    }
+
+    bool empty() const {
+        return values.empty();
+    }
+
+    /**
+     * @returns the number of the edge from -> to, -1 if there is no such edge
+     */
+    int find(int from, int to) const {
+        for (int i = offsets[from]; i < offsets[from + 1]; i++)
+            if (targets[i] == to)
+                return i;
+
+        return -1;
+    }
+
+    E &operator[](int edge) {
+        return values[edge];
+    }
+
+    const E &operator[](int edge) const {
+        return values[edge];
+    }
+};
+
 #endif // GRAPH_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Read-only view of a whole file
+ * Memory-mapped on Linux, so the pages are only loaded when touched, and shared by every thread reading them.
+ * Elsewhere the file is read into a buffer in one go.
+ */
+class MappedFile {
+    const char *bytes = nullptr;
+    size_t length = 0;
+
+    /**
+     * @brief fallback storage, when the file is not mapped
+     */
+    std::vector<char> buffer;
+
+    bool opened = false, mapped = false;
+
+  public:
+    /**
+     * @note check `is_open` afterwards
+     */
+    MappedFile(const std::string &filename);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    bool is_open() const {
+        return opened;
+    }
+
+    const char *data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    const char *begin() const {
+        return bytes;
+    }
+
+    const char *end() const {
+        return bytes + length;
+    }
+};
+
+#endif // MAPPED_H
@@ -0,0 +1,483 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "algorithm.h"
+#include "cli.h"
+#include "components.h"
+#include "diagnostics.h"
+#include "geo.h"
+#include "heap.h"
+#include "hierarchy.h"
+#include "lib.h"
+#include "query.h"
+#include "spatial.h"
+#include "util.h"
+#include "weights.h"
+#include "workspace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Matrix mode: the routes from every source to every target, with one loaded graph and without the GUI
+ */
+namespace matrix {
+
+static const uint32_t MAGIC = 0x4d46484e; // "NHFM"
+static const uint32_t VERSION = 1;
+
+/**
+ * @brief Routes from one source to every target of a fixed set
+ */
+class Search : public Counter, public virtual Sizable {
+  public:
+    /**
+     * @brief search from source, until the route to every target is known
+     */
+    virtual void run(int source) = 0;
+
+    /**
+     * @brief length and travel time of the route from the last source to the j-th target
+     * @returns false if there is no route
+     */
+    virtual bool route(size_t j, RouteInfo &info) const = 0;
+
+    virtual ~Search() = default;
+};
+
+/**
+ * @brief One-to-many: a single Dijkstra from the source, continued until every target is settled
+ * Targets in a component the source can't reach are not waited for (see `Components::reachable`).
+ * The length and the time of the routes are kept along the labels: once the search is over, they are filled in from the
+ * parent's for the vertices on the way to the targets, each vertex once, so shared beginnings of routes are measured once.
+ * @tparam Queue, W see `Dijkstra`
+ */
+template <typename T, typename Queue = LazyHeap, typename W = Weight<T>> class OneToMany : public Search {
+    const DiGraph<T> &graph;
+    const W &weight;
+    const Components<T> &components;
+    const EdgeRoads *roads;
+
+    const std::vector<int> targets;
+
+    /**
+     * @brief the distinct targets, and a flag for each vertex telling if it is one of them
+     */
+    std::vector<int> distinct;
+    std::vector<bool> wanted;
+
+    Workspace space;
+    Queue pq;
+
+    /**
+     * @brief length (m) and time (s) of the route to every measured vertex
+     */
+    std::vector<float> metres, seconds;
+
+    /**
+     * @brief the run every vertex was last measured in
+     */
+    std::vector<uint32_t> measured;
+    uint32_t runs = 0;
+
+    std::vector<int> stack;
+
+    /**
+     * @brief measure the route to a settled vertex, from its closest measured ancestor down
+     */
+    void measure(int v) {
+        for (int u = v; u >= 0 && measured[u] != runs; u = space.parent(u))
+            stack.push_back(u);
+
+        while (!stack.empty()) {
+            const int u = stack.back(), parent = space.parent(u);
+            stack.pop_back();
+
+            if (parent < 0) {
+                metres[u] = seconds[u] = 0.f;
+            } else {
+                const RouteInfo step = leg(graph, parent, u, roads);
+                metres[u] = metres[parent] + step.distance;
+                seconds[u] = seconds[parent] + step.time;
+            }
+
+            measured[u] = runs;
+        }
+    }
+
+  public:
+    /**
+     * @param roads road of every edge on merged graphs, see `leg`
+     */
+    OneToMany(const DiGraph<T> &graph, const W &weight, const Components<T> &components, const EdgeRoads *roads, const std::vector<int> &targets)
+        : graph(graph), weight(weight), components(components), roads(roads), targets(targets), //
+          wanted(graph.size(), false), space(graph.size()), pq(graph.size()), metres(graph.size()), seconds(graph.size()), measured(graph.size(), 0) {
+        for (int t : targets) {
+            if (!wanted[t])
+                distinct.push_back(t);
+
+            wanted[t] = true;
+        }
+    }
+
+    size_t size_of() const override {
+        return space.size_of() + pq.size_of() + true_size(distinct) + wanted.size() / 8 + true_size(metres) + true_size(seconds) + true_size(measured) + true_size(stack);
+    }
+
+    void run(int source) override {
+        space.reset();
+        pq.clear();
+
+        size_t remaining = 0;
+        for (int t : distinct)
+            remaining += components.reachable(source, t);
+
+        space.set(source, 0.f, -1);
+        pq.push(0.f, source);
+        this->mem(3);
+
+        while (remaining > 0 && !pq.empty()) {
+            const float d = pq.top().first;
+            const int current = pq.top().second;
+            pq.pop();
+            this->mem(2);
+
+            this->comp();
+            if (space.settled(current))
+                continue;
+
+            space.settle(current);
+            this->mem();
+
+            if (wanted[current])
+                remaining--;
+
+            for (int neighbor : graph.neighbors(current)) {
+                this->step();
+
+                this->mem();
+                const float w = weight.get(current, neighbor, space.parent(current), graph);
+
+                this->comp();
+                if (d + w < space.distance(neighbor)) {
+                    space.set(neighbor, d + w, current);
+
+                    pq.push(d + w, neighbor);
+                    this->mem(3);
+                }
+            }
+        }
+
+        // a new run invalidates the measurements, they are only cleared for real when the counter wraps around
+        if (++runs == 0) {
+            std::fill(measured.begin(), measured.end(), 0);
+            runs = 1;
+        }
+
+        for (int t : distinct)
+            if (space.settled(t))
+                measure(t);
+    }
+
+    bool route(size_t j, RouteInfo &info) const override {
+        if (!space.settled(targets[j]))
+            return false;
+
+        info.distance = metres[targets[j]];
+        info.time = seconds[targets[j]];
+        return true;
+    }
+};
+
+/**
+ * @returns length and travel time of an arc of the hierarchy, measured along the edges it stands for
+ * @param path buffer for the unpacked vertices
+ */
+template <typename T> RouteInfo unpacked(const Hierarchy<T> &hierarchy, const DiGraph<T> &graph, const EdgeRoads *roads, int from, int to, std::vector<int> &path) {
+    path.assign(1, from);
+    hierarchy.unpack(from, to, path);
+
+    return measure(graph, path, roads);
+}
+
+/**
+ * @brief The backward searches of the targets on a contraction hierarchy, stored in buckets at the vertices they settle
+ * Built once for a set of targets, then shared (read-only) by the forward searches of every source.
+ * Every entry also carries the length and the time of its way to the target, measured once here along the unpacked arcs.
+ */
+template <typename T> class Buckets : Sizable {
+  public:
+    struct Entry {
+        /**
+         * @brief index of the target
+         */
+        int target;
+
+        /**
+         * @brief distance from the vertex of the bucket to the target, along the downward arcs
+         */
+        float distance;
+
+        /**
+         * @brief the next vertex towards the target, -1 at the target itself
+         */
+        int next;
+
+        /**
+         * @brief length (m) and time (s) from the vertex of the bucket to the target
+         */
+        float metres, seconds;
+    };
+
+  private:
+    /**
+     * @brief the entries of every vertex (CSR)
+     */
+    std::vector<int> offsets;
+    std::vector<Entry> entries;
+
+  public:
+    /**
+     * @param graph, roads the graph the hierarchy was built of, and the road of its every edge on merged graphs (see `leg`)
+     */
+    Buckets(const Hierarchy<T> &hierarchy, const DiGraph<T> &graph, const EdgeRoads *roads, const std::vector<int> &targets) : offsets(hierarchy.size() + 1, 0) {
+        Workspace space(hierarchy.size());
+        LazyHeap pq(hierarchy.size());
+
+        // length and time to the target of every settled vertex of the current search
+        std::vector<float> metres(hierarchy.size()), seconds(hierarchy.size());
+        std::vector<int> path;
+
+        std::vector<std::pair<int, Entry>> found;
+
+        for (size_t j = 0; j < targets.size(); j++) {
+            space.reset();
+            pq.clear();
+
+            space.set(targets[j], 0.f, -1);
+            pq.push(0.f, targets[j]);
+
+            while (!pq.empty()) {
+                const float d = pq.top().first;
+                const int current = pq.top().second;
+                pq.pop();
+
+                if (space.settled(current))
+                    continue;
+
+                space.settle(current);
+
+                // the arc leads from the settled vertex to its parent, which is closer to the target
+                const int next = space.parent(current);
+                if (next < 0) {
+                    metres[current] = seconds[current] = 0.f;
+                } else {
+                    const RouteInfo arc = unpacked(hierarchy, graph, roads, current, next, path);
+                    metres[current] = arc.distance + metres[next];
+                    seconds[current] = arc.time + seconds[next];
+                }
+
+                found.push_back({current, Entry{(int)j, d, next, metres[current], seconds[current]}});
+
+                for (const auto &arc : hierarchy.downward(current)) {
+                    if (d + arc.weight < space.distance(arc.to)) {
+                        space.set(arc.to, d + arc.weight, current);
+                        pq.push(d + arc.weight, arc.to);
+                    }
+                }
+            }
+        }
+
+        // counting sort by vertex
+        for (const auto &f : found)
+            offsets[f.first + 1]++;
+
+        for (size_t v = 1; v < offsets.size(); v++)
+            offsets[v] += offsets[v - 1];
+
+        entries.resize(found.size());
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+
+        for (const auto &f : found)
+            entries[fill[f.first]++] = f.second;
+    }
+
+    size_t size_of() const override {
+        return true_size(offsets) + true_size(entries);
+    }
+
+    /**
+     * @brief Entries of a single vertex
+     */
+    struct Range {
+        const Entry *first, *last;
+
+        const Entry *begin() const {
+            return first;
+        }
+
+        const Entry *end() const {
+            return last;
+        }
+    };
+
+    Range at(int v) const {
+        return Range{entries.data() + offsets[v], entries.data() + offsets[v + 1]};
+    }
+};
+
+/**
+ * @brief Many-to-many on a contraction hierarchy: every source runs one upward search, and meets all targets in the buckets
+ * The upward searches are small, so each one runs to the end instead of stopping at a bound.
+ * The length and the time of the upward route to every settled vertex are carried along with its label, measured along
+ * the unpacked arc from its parent, and added to the ones of the bucket entry where a target is met.
+ */
+template <typename T> class ManyToMany : public Search {
+    const Hierarchy<T> &hierarchy;
+    const Buckets<T> &buckets;
+    const DiGraph<T> &graph;
+    const EdgeRoads *roads;
+
+    Workspace space;
+    LazyHeap pq;
+
+    /**
+     * @brief length (m) and time (s) of the upward route to every settled vertex
+     */
+    std::vector<float> metres, seconds;
+
+    /**
+     * @brief buffer of the unpacked arcs
+     */
+    std::vector<int> path;
+
+    /**
+     * @brief the shortest distance to every target, and the length and the time of the route it belongs to
+     */
+    std::vector<float> best;
+    std::vector<RouteInfo> info;
+
+  public:
+    /**
+     * @param graph, roads see `Buckets`
+     */
+    ManyToMany(const Hierarchy<T> &hierarchy, const Buckets<T> &buckets, const DiGraph<T> &graph, const EdgeRoads *roads, const std::vector<int> &targets)
+        : hierarchy(hierarchy), buckets(buckets), graph(graph), roads(roads), //
+          space(hierarchy.size()), pq(hierarchy.size()), metres(hierarchy.size()), seconds(hierarchy.size()), best(targets.size()), info(targets.size()) {}
+
+    size_t size_of() const override {
+        return space.size_of() + pq.size_of() + true_size(metres) + true_size(seconds) + true_size(path) + true_size(best) + true_size(info);
+    }
+
+    void run(int source) override {
+        space.reset();
+        pq.clear();
+
+        std::fill(best.begin(), best.end(), FMAX);
+
+        space.set(source, 0.f, -1);
+        pq.push(0.f, source);
+        this->mem(3);
+
+        while (!pq.empty()) {
+            const float d = pq.top().first;
+            const int current = pq.top().second;
+            pq.pop();
+            this->mem(2);
+
+            this->comp();
+            if (space.settled(current))
+                continue;
+
+            space.settle(current);
+
+            const int parent = space.parent(current);
+            if (parent < 0) {
+                metres[current] = seconds[current] = 0.f;
+            } else {
+                const RouteInfo arc = unpacked(hierarchy, graph, roads, parent, current, path);
+                metres[current] = metres[parent] + arc.distance;
+                seconds[current] = seconds[parent] + arc.time;
+            }
+            this->mem(4);
+
+            for (const auto &e : buckets.at(current)) {
+                this->step();
+
+                this->comp();
+                if (d + e.distance < best[e.target]) {
+                    best[e.target] = d + e.distance;
+                    info[e.target].distance = metres[current] + e.metres;
+                    info[e.target].time = seconds[current] + e.seconds;
+                    this->mem(3);
+                }
+            }
+
+            for (const auto &arc : hierarchy.upward(current)) {
+                this->step();
+
+                this->comp();
+                if (d + arc.weight < space.distance(arc.to)) {
+                    space.set(arc.to, d + arc.weight, current);
+
+                    pq.push(d + arc.weight, arc.to);
+                    this->mem(3);
+                }
+            }
+        }
+    }
+
+    bool route(size_t j, RouteInfo &info) const override {
+        if (best[j] == FMAX)
+            return false;
+
+        info = this->info[j];
+        return true;
+    }
+};
+
+/**
+ * @brief Read the points of a sources or targets file, one per line: `lat,lon`
+ * Empty lines, lines starting with '#' and a header line are skipped.
+ * @throws std::invalid_argument on a malformed line
+ */
+std::vector<Point> read(const std::string &filename);
+
+/**
+ * @brief Snap the points to the closest vertices of the largest component, see `::snap`
+ */
+std::vector<int> snap(const std::vector<Point> &points, const KDTree<Node> &index, const Components<Node> &components);
+
+/**
+ * @brief Creates a new search, one is made for every worker thread
+ */
+using Factory = std::function<Search *()>;
+
+/**
+ * @brief Instantiate the search of the matrix: many-to-many on the hierarchy with CH, one-to-many Dijkstra otherwise
+ * @param roads road of every edge on merged graphs, see `leg`
+ * @param buckets backward searches of the targets, required by CH
+ * @throws std::invalid_argument if the search can't be created
+ */
+Search *select(const cli::Options &options, const DiGraph<Node> &graph, const Weight<Node> *weight, const Components<Node> &components, const EdgeRoads *roads, //
+               const Hierarchy<Node> *hierarchy, const Buckets<Node> *buckets, const std::vector<int> &targets);
+
+/**
+ * @brief Route every source to every target, and write the dense matrices to `os`
+ * The sources are handed out to the worker threads in small chunks, every worker owns a search.
+ * Distances (m) and times (s) are summed edge by edge like in the batch mode (see `leg`), but along the labels of the
+ * searches instead of walking every route; pairs without a route are left empty in CSV, null in JSON and NaN in the binary format.
+ * Binary: "NHFM" magic, uint32 version, uint32 number of sources and targets, then the distances and the times
+ * as row-major float32 matrices (one row per source), in the byte order of the machine.
+ * @param sources, targets vertices, the searches are made for the same targets
+ * @param threads number of workers, at least 1
+ */
+void run(const std::vector<int> &sources, const std::vector<int> &targets, const Factory &create, unsigned int threads, cli::Format format, std::ostream &os);
+
+} // namespace matrix
+
+#endif // MATRIX_H
@@ -3,8 +3,12 @@
 
 #include "algorithm.h"
 #include "cli.h"
+#include "components.h"
 #include "geo.h"
+#include "hierarchy.h"
+#include "landmarks.h"
 #include "map.h"
+#include "weights.h"
 
 #include <string>
 #include <vector>
@@ -14,7 +18,12 @@ class Network {
     Map map;
 
     const DiGraph<Node> &graph;
-    const std::vector<Road *> &roads;
+    const Roads &roads;
+
+    /**
+     * @brief road of every edge, on merged graphs
+     */
+    const EdgeRoads *edge_roads;
 
     glm::vec2 transform(const Point &p, const Point &translate = Point()) {
         return {p.x, p.y};
@@ -26,6 +35,11 @@ class Network {
         Idle,
     } state = Stage::Trace;
 
+    /**
+     * @brief number of trace segments drawn so far
+     */
+    size_t traced = 0;
+
     /**
      * @brief add edges to graphics buffer, set panzoom to fit the middle of points
      */
@@ -35,7 +49,7 @@ class Network {
      * @brief trace down the visited nodes
      * @returns true if the trace has been consumed
      */
-    bool trace(Algorithm<Node>::Trace &trace, const int spread_rate = 1000);
+    bool trace(const Algorithm<Node>::Trace &trace, const int spread_rate = 1000);
 
     /**
      * @brief renders a new section of the route path
@@ -44,7 +58,7 @@ class Network {
     bool route(const std::vector<int> &path, const int route_rate = 20);
 
   public:
-    Network(const DiGraph<Node> &_graph, const std::vector<Road *> &_roads) : graph(_graph), roads(_roads) {
+    Network(const DiGraph<Node> &_graph, const Roads &_roads, const EdgeRoads *_edge_roads = nullptr) : graph(_graph), roads(_roads), edge_roads(_edge_roads) {
         setup();
     }
 
@@ -56,18 +70,44 @@ class Network {
      * 3. then animates the route from source to target
      */
     void run(Algorithm<Node> &algo, const std::vector<int> &path, const int source, const int target, const cli::Options &options);
-
-    ~Network() {
-        for (Road *p : roads)
-            delete p;
-    }
 };
 
 namespace loader {
 
-std::vector<Road *> from_file(const std::string &filename, bool use_cache = true);
-
-DiGraph<Node> construct(const std::vector<Road *> &roads, const cli::Options &opts);
+/**
+ * @brief Load the roads of a .geojsonl map, or of its cache if there is one
+ * The map is memory-mapped and split at line boundaries into chunks, which are parsed in parallel.
+ * @param threads number of parser threads, 0 to use every hardware thread
+ */
+Roads from_file(const std::string &filename, bool use_cache = true, unsigned int threads = 0);
+
+/**
+ * @brief Build the graph of the roads with the chosen driver.
+ * Loaded from `<map>.<driver>.graph.bin` (`<map>.merged.<driver>.graph.bin` with `--merge`) if it was made of the current map,
+ * built and saved there otherwise. With `--prune` only the largest strongly connected component is kept (and `.pruned` is added to `<map>`).
+ * @param edge_roads filled with the road of every edge if the points are merged, left empty otherwise
+ * @param components receives the strongly connected components of the graph, saved along with it
+ */
+DiGraph<Node> construct(const Roads &roads, const cli::Options &opts, EdgeRoads &edge_roads, Components<Node> &components);
+
+/**
+ * @brief Load the weights of the edges (and turns) of the graph for the chosen weight profile.
+ * Computed and saved next to the map as `<map>.<profile>.weights.bin` if missing or stale (`.merged` and `.pruned` are added to `<map>` by those options).
+ * @param weight the weight to materialize, owned by the result from now on
+ */
+EdgeWeights *weights(const DiGraph<Node> &graph, const Weight<Node> *weight, const cli::Options &opts);
+
+/**
+ * @brief Load the contraction hierarchy of the graph for the chosen weight profile.
+ * Built and saved next to the map as `<map>.<profile>.ch.bin` if missing or stale (`.merged`, `.pruned` and `.compressed` are added to `<map>` by those options).
+ */
+Hierarchy<Node> *hierarchy(const DiGraph<Node> &graph, const Weight<Node> &weight, const cli::Options &opts);
+
+/**
+ * @brief Load the ALT landmark distances of the graph for the chosen weight profile.
+ * Computed and saved next to the map as `<map>.<profile>.alt.bin` if missing or stale (`.merged`, `.pruned` and `.compressed` are added to `<map>` by those options).
+ */
+Landmarks<Node> *landmarks(const DiGraph<Node> &graph, const Weight<Node> &weight, const cli::Options &opts);
 
 }; // namespace loader
 
@@ -0,0 +1,58 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "algorithm.h"
+#include "cli.h"
+#include "components.h"
+#include "geo.h"
+#include "hierarchy.h"
+#include "lib.h"
+#include "spatial.h"
+#include "weights.h"
+
+#include <vector>
+
+/**
+ * @brief Length and estimated travel time of a found route
+ */
+struct RouteInfo {
+    /**
+     * @brief in metres
+     */
+    float distance = 0.f;
+
+    /**
+     * @brief in seconds
+     */
+    float time = 0.f;
+};
+
+/**
+ * @brief Instantiate the search algorithm chosen on the command line
+ * @param estimate heuristic of the A* variants
+ * @param hierarchy preprocessed graph, required by CH
+ * @throws std::invalid_argument if the algorithm can't be created
+ */
+Algorithm<Node> *algoselect(const cli::Options &options, const DiGraph<Node> &graph, Weight<Node> *weight, const Weight<Node> *estimate = &heuristic, const Hierarchy<Node> *hierarchy = nullptr);
+
+/**
+ * @brief Snap a location to the closest vertex of the largest strongly connected component
+ * Without `--prune` the graph keeps its small components (a parking lot, a one-way stub), and a point snapped into
+ * one of them has no route to most of the map.
+ * @returns -1 if the graph is empty
+ */
+int snap(const KDTree<Node> &index, const Components<Node> &components, const Point &location);
+
+/**
+ * @brief Length and travel time (by the speed limits, at least 30 km/h) of a single edge
+ * @param roads road of every edge on merged graphs, the speed limits are taken from the vertices' roads without it
+ */
+RouteInfo leg(const DiGraph<Node> &graph, int from, int to, const EdgeRoads *roads = nullptr);
+
+/**
+ * @brief Sum the length and the travel time of a path, edge by edge (see `leg`)
+ * @param roads see `leg`
+ */
+RouteInfo measure(const DiGraph<Node> &graph, const std::vector<int> &path, const EdgeRoads *roads = nullptr);
+
+#endif // QUERY_H
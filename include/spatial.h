@@ -0,0 +1,171 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "consts.h"
+#include "diagnostics.h"
+#include "geo.h"
+#include "lib.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Static KD-tree over the locations of the graph's vertices, for snapping coordinates to the graph
+ * The points are projected onto a plane (equirectangular, longitudes scaled by the cosine of the mean latitude),
+ * which is accurate enough for the extent of a city map. The tree is implicit: the median of every range
+ * [lo, hi) is at its middle, the left half holds the smaller, the right half the larger coordinates.
+ * The split axis alternates with the depth.
+ */
+template <typename T> class KDTree : Sizable {
+    struct Item {
+        float x, y;
+        int id;
+    };
+
+    std::vector<Item> items;
+
+    /**
+     * @brief scale of the longitudes, so that both axes have the same unit
+     */
+    float scale = 1.f;
+
+    Item project(const Point &p, int id = -1) const {
+        // Point::x is the longitude, Point::y the latitude
+        return Item{p.x * scale, p.y, id};
+    }
+
+    static float coord(const Item &item, int axis) {
+        return axis == 0 ? item.x : item.y;
+    }
+
+    static float distance_sq(const Item &a, const Item &b) {
+        return pow2(a.x - b.x) + pow2(a.y - b.y);
+    }
+
+    void build(size_t lo, size_t hi, int axis) {
+        if (hi - lo <= 1)
+            return;
+
+        const size_t mid = lo + (hi - lo) / 2;
+        std::nth_element(items.begin() + lo, items.begin() + mid, items.begin() + hi, //
+                         [axis](const Item &a, const Item &b) { return coord(a, axis) < coord(b, axis); });
+
+        build(lo, mid, axis ^ 1);
+        build(mid + 1, hi, axis ^ 1);
+    }
+
+    /**
+     * @brief max-heap of the k best candidates: (squared distance, id)
+     */
+    using Candidates = std::vector<std::pair<float, int>>;
+
+    /**
+     * @param accept filter of the vertices, the rejected ones are still used for the descent but never become candidates
+     */
+    template <typename F> void search(size_t lo, size_t hi, int axis, const Item &query, size_t k, Candidates &best, const F &accept) const {
+        if (lo >= hi)
+            return;
+
+        const size_t mid = lo + (hi - lo) / 2;
+        const Item &item = items[mid];
+
+        // on equal distances the smaller id wins, so co-located vertices are resolved deterministically
+        const std::pair<float, int> candidate(distance_sq(query, item), item.id);
+        if ((best.size() < k || candidate < best.front()) && accept(item.id)) {
+            if (best.size() == k) {
+                std::pop_heap(best.begin(), best.end());
+                best.pop_back();
+            }
+
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end());
+        }
+
+        // descend into the half of the query first, the other half only if the splitting line is closer than the k-th best
+        const float delta = coord(query, axis) - coord(item, axis);
+        const bool left = delta < 0;
+
+        if (left)
+            search(lo, mid, axis ^ 1, query, k, best, accept);
+        else
+            search(mid + 1, hi, axis ^ 1, query, k, best, accept);
+
+        if (best.size() < k || pow2(delta) <= best.front().first) {
+            if (left)
+                search(mid + 1, hi, axis ^ 1, query, k, best, accept);
+            else
+                search(lo, mid, axis ^ 1, query, k, best, accept);
+        }
+    }
+
+  public:
+    KDTree(const DiGraph<T> &graph) {
+        const size_t n = graph.size();
+        if (n == 0)
+            return;
+
+        float latitude = 0.f;
+        for (size_t v = 0; v < n; v++)
+            latitude += static_cast<const Point &>(graph.at(v)).y;
+
+        scale = std::cos(rad(latitude / n));
+
+        items.reserve(n);
+        for (size_t v = 0; v < n; v++)
+            items.push_back(project(graph.at(v), v));
+
+        build(0, items.size(), 0);
+    }
+
+    size_t size_of() const override {
+        return true_size(items);
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    /**
+     * @returns the vertex closest to the location, -1 if the tree is empty
+     */
+    int nearest(const Point &location) const {
+        const std::vector<int> found = nearest(location, 1);
+        return found.empty() ? -1 : found.front();
+    }
+
+    /**
+     * @returns the vertex closest to the location among the ones `accept` returns true for, -1 if there is none
+     * @note the tree is pruned by the distance of the best accepted vertex, so a rare filter means a long search
+     */
+    template <typename F> int nearest_if(const Point &location, const F &accept) const {
+        Candidates best;
+        search(0, items.size(), 0, project(location), 1, best, accept);
+
+        return best.empty() ? -1 : best.front().second;
+    }
+
+    /**
+     * @returns the k vertices closest to the location, nearest first
+     */
+    std::vector<int> nearest(const Point &location, size_t k) const {
+        Candidates best;
+        best.reserve(k + 1);
+
+        if (k > 0)
+            search(0, items.size(), 0, project(location), k, best, [](int) { return true; });
+
+        std::sort_heap(best.begin(), best.end());
+
+        std::vector<int> ids;
+        ids.reserve(best.size());
+        for (const auto &candidate : best)
+            ids.push_back(candidate.second);
+
+        return ids;
+    }
+};
+
+#endif // SPATIAL_H
@@ -2,6 +2,8 @@
 #define UTIL_H
 
 #include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <queue>
@@ -64,6 +66,25 @@ class Serializable {
     virtual void write(std::ostream &os) const = 0;
     virtual void read(std::istream &is) = 0;
 
+    /**
+     * @brief write a vector of trivially copyable items in one block, prefixed by its size
+     */
+    template <class T> static void write_pod(std::ostream &os, const std::vector<T> &vec) {
+        size_t vec_size = vec.size();
+        os.write(reinterpret_cast<const char *>(&vec_size), sizeof(vec_size));
+        os.write(reinterpret_cast<const char *>(vec.data()), sizeof(T) * vec_size);
+    }
+
+    /**
+     * @brief read a vector written by write_pod
+     */
+    template <class T> static void read_pod(std::istream &is, std::vector<T> &vec) {
+        size_t vec_size = 0;
+        is.read(reinterpret_cast<char *>(&vec_size), sizeof(vec_size));
+        vec.resize(is ? vec_size : 0);
+        is.read(reinterpret_cast<char *>(vec.data()), sizeof(T) * vec.size());
+    }
+
     template <class T> static void read(const char *filename, T &obj) {
         std::ifstream file = fopen<std::ifstream>(filename);
         obj.read(file);
@@ -183,6 +204,73 @@ template <> inline float as_stream(const std::string &s) {
     return std::atof(s.c_str());
 }
 
+/**
+ * Parse a decimal number (`[-]digits[.digits][e[+-]digits]`) in place, without going through a stream.
+ * Correctly rounded for up to 15 significant digits (plenty for coordinates), longer ones are truncated to 19 digits.
+ * @param p start of the number, moved past it on success
+ * @returns false if there is no number at p
+ */
+inline bool number(const char *&p, const char *end, double &out) {
+    static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *c = p;
+    const bool negative = c < end && *c == '-';
+    if (c < end && (*c == '-' || *c == '+'))
+        c++;
+
+    uint64_t mantissa = 0;
+    int exponent = 0, significant = 0;
+    bool digits = false;
+
+    for (; c < end && *c >= '0' && *c <= '9'; c++, digits = true) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (*c - '0');
+            significant += mantissa != 0;
+        } else
+            exponent++;
+    }
+
+    if (c < end && *c == '.') {
+        for (c++; c < end && *c >= '0' && *c <= '9'; c++, digits = true) {
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (*c - '0');
+                significant += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!digits)
+        return false;
+
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        const char *e = c + 1;
+        const bool e_negative = e < end && *e == '-';
+        if (e < end && (*e == '-' || *e == '+'))
+            e++;
+
+        if (e < end && *e >= '0' && *e <= '9') {
+            int value = 0;
+            for (; e < end && *e >= '0' && *e <= '9'; e++)
+                value = std::min(value * 10 + (*e - '0'), 1000);
+
+            exponent += e_negative ? -value : value;
+            c = e;
+        }
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0)
+        value = -exponent <= 22 ? value / POW10[-exponent] : value * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * POW10[exponent] : value * std::pow(10.0, exponent);
+
+    out = negative ? -value : value;
+    p = c;
+    return true;
+}
+
 /**
  * Insert operator wrapper for simple strings.
  * T must be a type that has the insert operator overloaded!
@@ -5,6 +5,9 @@
 #include "geo.h"
 
 #include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 enum class RouteOpt {
     Shortest,
@@ -61,7 +64,9 @@ std::istream &operator>>(std::istream &is, Coefficients &coeffs);
 /**
  * @brief Weight that goes for the shortest path
  */
-struct Shortest : Weight<Node> {
+struct Shortest final : Weight<Node> {
+    using Weight<Node>::get;
+
     /**
      * @brief Weight is the distance in metres + 0.1
      */
@@ -73,7 +78,9 @@ struct Shortest : Weight<Node> {
 /**
  * @brief Heuristic weight function - the goal is to give an estimate of the distance (weight) without using much compute
  */
-struct Heuristic : Weight<Node> {
+struct Heuristic final : Weight<Node> {
+    using Weight<Node>::get;
+
     float get(const Node &from, const Node &to, const Node *prev) const override {
         return 1.f + 1000 * Point::distance_sq(from, to);
     }
@@ -82,14 +89,16 @@ struct Heuristic : Weight<Node> {
 /**
  * @brief Finds the fastest, most sane route.
  */
-struct Fastest : Weight<Node> {
+struct Fastest final : Weight<Node> {
+    using Weight<Node>::get;
+
     float get(const Node &from, const Node &to, const Node *prev) const override;
 };
 
 /**
  * @brief User-adjustable weight class
  */
-class Custom : public Weight<Node> {
+class Custom final : public Weight<Node> {
     const Coefficients coeffs;
 
   public:
@@ -99,9 +108,148 @@ class Custom : public Weight<Node> {
      */
     Custom(const Coefficients &coeffs) : coeffs(std::move(coeffs)) {};
 
+    using Weight<Node>::get;
+
     float get(const Node &from, const Node &to, const Node *prev) const override;
 };
 
+/**
+ * @brief Road of every edge, for graphs whose vertices are shared by several roads (see `--merge`)
+ */
+using EdgeRoads = EdgeMap<Road *>;
+
+/**
+ * @brief Weighs the edges of a merged graph on the road they belong to
+ * The vertex of an intersection carries only one of its roads, so both ends of an edge are given the road of the edge instead.
+ */
+class OnEdgeRoads final : public Weight<Node> {
+    const Weight<Node> *base;
+    const EdgeRoads &roads;
+
+  public:
+    /**
+     * @param base the weight to apply, owned from now on
+     */
+    OnEdgeRoads(const Weight<Node> *base, const EdgeRoads &roads) : base(base), roads(roads) {};
+
+    float get(const Node &from, const Node &to, const Node *prev) const override {
+        return base->get(from, to, prev);
+    }
+
+    float get(int from, int to, int prev, const DiGraph<Node> &graph) const override {
+        const int edge = roads.find(from, to);
+        if (edge < 0)
+            return base->get(from, to, prev, graph);
+
+        Road *road = roads[edge];
+        return base->get(Node(road, graph.at(from).loc), Node(road, graph.at(to).loc), prev < 0 ? nullptr : &graph.at(prev));
+    }
+
+    ~OnEdgeRoads() {
+        delete base;
+    }
+};
+
+/**
+ * @brief A weight materialized on the edges of a graph: computed once per profile, then looked up on every relaxation
+ * Every weight is a static cost of the edge, plus a penalty that depends on the previous vertex (a turn). The static
+ * costs are stored per edge. The turns are kept apart, and only where they cost extra: for every edge, the previous
+ * vertices whose weight differs from the static one, along with that weight. Most turns are straight enough to cost
+ * nothing, so the table is small.
+ */
+class EdgeWeights final : public Weight<Node>, public Serializable, Sizable {
+    static const uint32_t MAGIC = 0x54475745; // "EWGT"
+    static const uint32_t VERSION = 2;
+
+    /**
+     * @brief the weight materialized, owned; edges outside the graph and vertices without an index are weighed with it
+     */
+    const Weight<Node> *base;
+
+    /**
+     * @brief weight of every edge without a turn
+     */
+    EdgeMap<float> cost;
+
+    /**
+     * @brief the turns of every edge (CSR over the edges): the previous vertex, and the weight of the edge after it
+     */
+    std::vector<int> turn_offsets;
+    std::vector<int> turn_prev;
+    std::vector<float> turn_weight;
+
+    /**
+     * @brief checksum of the adjacency the weights were computed for, used to detect stale files
+     */
+    uint64_t signature = 0;
+
+    /**
+     * @brief size and modification time of the map the weights were computed of, see `cache::stamp`
+     */
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+
+    static uint64_t adjacency(const DiGraph<Node> &graph);
+
+  public:
+    /**
+     * @param base the weight to materialize, owned from now on
+     */
+    EdgeWeights(const Weight<Node> *base) : base(base) {};
+
+    /**
+     * @brief weigh every edge, and every turn onto it
+     * @param map the map the graph was made of, its stamp is stored with the weights
+     */
+    void build(const DiGraph<Node> &graph, const std::string &map);
+
+    /**
+     * @brief attach the weights read from a file to the edges of the graph
+     * @returns false if they were computed for another graph, or for an other version of the map
+     * @note if the map itself is missing, only the graph is checked
+     */
+    bool bind(const DiGraph<Node> &graph, const std::string &map);
+
+    float get(const Node &from, const Node &to, const Node *prev) const override {
+        return base->get(from, to, prev);
+    }
+
+    float get(int from, int to, int prev, const DiGraph<Node> &graph) const override {
+        const int edge = cost.find(from, to);
+        if (edge < 0)
+            return base->get(from, to, prev, graph);
+
+        if (prev >= 0)
+            for (int i = turn_offsets[edge]; i < turn_offsets[edge + 1]; i++)
+                if (turn_prev[i] == prev)
+                    return turn_weight[i];
+
+        return cost[edge];
+    }
+
+    size_t size_of() const override {
+        return cost.size_of() + true_size(turn_offsets) + true_size(turn_prev) + true_size(turn_weight);
+    }
+
+    /**
+     * @returns number of turns with a weight of their own
+     */
+    size_t turns() const {
+        return turn_prev.size();
+    }
+
+    void write(std::ostream &os) const override;
+
+    /**
+     * @note the weights are detached from the edges until `bind`; on a foreign or damaged file the signature is left 0, so that it fails
+     */
+    void read(std::istream &is) override;
+
+    ~EdgeWeights() {
+        delete base;
+    }
+};
+
 /**
  * @brief Create a Weight instance
  * @param type the routing option to use (Fastest, Shortest, or Custom)
@@ -109,4 +257,10 @@ class Custom : public Weight<Node> {
  */
 Weight<Node> *create(RouteOpt type = RouteOpt::Fastest, const Coefficients *coeffs = nullptr);
 
+/**
+ * @brief Name of a weight profile, for keying the files precomputed with it
+ * @returns "fastest", "shortest" or "custom-<hash of the coefficients>"
+ */
+std::string profile(RouteOpt type, const Coefficients *coeffs = nullptr);
+
 #endif // WEIGHTS_H
\ No newline at end of file
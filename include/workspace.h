@@ -0,0 +1,104 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include "consts.h"
+#include "diagnostics.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Per-vertex state of a search: tentative distance, parent and settled flag.
+ * Allocated once, then reused by every query. An entry is only valid if it was written in the current
+ * generation, so `reset` just starts a new generation instead of refilling the arrays.
+ */
+class Workspace : Sizable {
+    struct Entry {
+        float distance;
+        int parent;
+        uint32_t stamp;
+        bool settled;
+    };
+
+    std::vector<Entry> entries;
+
+    /**
+     * @brief stamp of the current query, entries with an other stamp read as untouched
+     */
+    uint32_t generation = 1;
+
+    Entry &touch(int v) {
+        Entry &e = entries[v];
+
+        if (e.stamp != generation)
+            e = {FMAX, -1, generation, false};
+
+        return e;
+    }
+
+  public:
+    Workspace(size_t vertices) : entries(vertices, Entry{FMAX, -1, 0, false}) {}
+
+    size_t size_of() const override {
+        return true_size(entries);
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    /**
+     * @brief invalidate every entry, in O(1)
+     * @note the stamps are only cleared for real once the generation counter wraps around
+     */
+    void reset() {
+        if (++generation == 0) {
+            for (Entry &e : entries)
+                e.stamp = 0;
+
+            generation = 1;
+        }
+    }
+
+    /**
+     * @returns true if v was written since the last reset
+     */
+    bool touched(int v) const {
+        return entries[v].stamp == generation;
+    }
+
+    /**
+     * @returns the tentative distance of v, FMAX if it was not reached
+     */
+    float distance(int v) const {
+        return touched(v) ? entries[v].distance : FMAX;
+    }
+
+    /**
+     * @returns the parent of v, -1 if it has none
+     */
+    int parent(int v) const {
+        return touched(v) ? entries[v].parent : -1;
+    }
+
+    bool settled(int v) const {
+        return touched(v) && entries[v].settled;
+    }
+
+    /**
+     * @brief record a (better) path to v
+     */
+    void set(int v, float distance, int parent) {
+        Entry &e = touch(v);
+        e.distance = distance;
+        e.parent = parent;
+    }
+
+    void settle(int v) {
+        touch(v).settled = true;
+    }
+};
+
+#endif // WORKSPACE_H
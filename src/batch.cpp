@@ -0,0 +1,193 @@
+#include "batch.h"
+#include "diagnostics.h"
+#include "query.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace batch {
+
+/**
+ * @brief split a line into the two points: at the first whitespace or ';' if there is one, otherwise at the second comma
+ */
+static Query parse(const std::string &line) {
+    size_t split = line.find_first_of(" \t;");
+    size_t rest = line.find_first_not_of(" \t;", split);
+
+    if (split == std::string::npos) {
+        split = line.find(',', line.find(',') + 1);
+        rest = split + 1;
+    }
+
+    if (split == std::string::npos || rest == std::string::npos)
+        throw std::invalid_argument("expected two points");
+
+    return Query{Point::parse(line.substr(0, split)), Point::parse(line.substr(rest))};
+}
+
+std::vector<Query> read(const std::string &filename) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::invalid_argument("failed to open query file '" + filename + "'");
+
+    std::vector<Query> queries;
+    std::string line;
+
+    for (int n = 1; std::getline(file, line); n++) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        // header, eg. "src_lat,src_lon,dst_lat,dst_lon"
+        if (queries.empty() && std::isalpha(static_cast<unsigned char>(line[0])))
+            continue;
+
+        try {
+            queries.push_back(parse(line));
+        } catch (const std::invalid_argument &e) {
+            throw std::invalid_argument(filename + ":" + std::to_string(n) + ": invalid query '" + line + "' (" + e.what() + ")");
+        }
+    }
+
+    return queries;
+}
+
+/**
+ * @brief outcome of one query
+ */
+struct Record {
+    int source, target;
+    bool found;
+    RouteInfo info;
+    uint64_t steps, comparisons, memops;
+    double ms;
+};
+
+/**
+ * @brief number of queries a worker claims at once, small enough to balance uneven queries
+ */
+static const size_t CHUNK = 16;
+
+/**
+ * @brief route queries until there are none left, claiming them in chunks through `next`
+ */
+static void work(const std::vector<Query> &queries, const DiGraph<Node> &graph, const EdgeRoads *roads, const KDTree<Node> &index, const Components<Node> &components, Algorithm<Node> &algo, std::atomic<size_t> &next, std::vector<Record> &records) {
+    Bench search;
+
+    for (size_t begin = next.fetch_add(CHUNK); begin < queries.size(); begin = next.fetch_add(CHUNK)) {
+        const size_t end = std::min(begin + CHUNK, queries.size());
+
+        for (size_t i = begin; i < end; i++) {
+            Record &r = records[i];
+            r.source = snap(index, components, queries[i].source);
+            r.target = snap(index, components, queries[i].target);
+
+            algo.reset();
+
+            search.start();
+            algo.run(r.source, r.target, true);
+            const std::vector<int> path = algo.reconstruct(r.source, r.target);
+            r.ms = search.elapsed(true);
+
+            r.found = !path.empty();
+            r.info = measure(graph, path, roads);
+            r.steps = algo.steps;
+            r.comparisons = algo.comparisons;
+            r.memops = algo.memops;
+        }
+    }
+}
+
+static void write(const std::vector<Record> &records, cli::Format format, std::ostream &os) {
+    const bool json = format == cli::Format::JSON;
+
+    os << std::fixed << std::setprecision(3);
+
+    if (json)
+        os << "[\n";
+    else
+        os << "id,source,target,found,distance,time,steps,comparisons,memops,ms\n";
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const Record &r = records[i];
+
+        if (json) {
+            os << "  {\"id\": " << i << ", \"source\": " << r.source << ", \"target\": " << r.target //
+               << ", \"found\": " << (r.found ? "true" : "false");
+
+            if (r.found)
+                os << ", \"distance\": " << r.info.distance << ", \"time\": " << r.info.time;
+            else
+                os << ", \"distance\": null, \"time\": null";
+
+            os << ", \"steps\": " << r.steps << ", \"comparisons\": " << r.comparisons //
+               << ", \"memops\": " << r.memops << ", \"ms\": " << r.ms << "}"            //
+               << (i + 1 < records.size() ? ",\n" : "\n");
+        } else {
+            os << i << ',' << r.source << ',' << r.target << ',' << r.found << ',';
+
+            if (r.found)
+                os << r.info.distance << ',' << r.info.time;
+            else
+                os << ',';
+
+            os << ',' << r.steps << ',' << r.comparisons << ',' << r.memops << ',' << r.ms << '\n';
+        }
+    }
+
+    if (json)
+        os << "]\n";
+
+    os.flush();
+}
+
+void run(const std::vector<Query> &queries, const DiGraph<Node> &graph, const EdgeRoads *roads, const KDTree<Node> &index, const Components<Node> &components, const Factory &create, unsigned int threads, cli::Format format, std::ostream &os) {
+    threads = std::max(1u, std::min<unsigned int>(threads, (queries.size() + CHUNK - 1) / CHUNK));
+
+    std::vector<Record> records(queries.size());
+    std::atomic<size_t> next(0);
+
+    // every worker owns its algorithm (workspace, queues, trace), the graph and the weights are only read
+    std::vector<std::unique_ptr<Algorithm<Node>>> algos;
+    for (unsigned int t = 0; t < threads; t++) {
+        algos.emplace_back(create());
+
+        // nothing is drawn: the searches don't record their trace
+        algos.back()->record(false);
+    }
+
+    Bench total("Batch");
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; t++)
+        workers.emplace_back(work, std::cref(queries), std::cref(graph), roads, std::cref(index), std::cref(components), std::ref(*algos[t]), std::ref(next), std::ref(records));
+
+    work(queries, graph, roads, index, components, *algos[0], next, records);
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    const double elapsed = total.elapsed(true);
+
+    write(records, format, os);
+
+    // keep stdout machine readable, the summary goes to stderr
+    double searching = 0;
+    for (const Record &r : records)
+        searching += r.ms;
+
+    std::cerr << "Routed " << queries.size() << " queries in " << elapsed << "ms on " << threads << " thread(s)" << (Counter::enabled ? "" : ", counters compiled out");
+    if (!queries.empty())
+        std::cerr << " (" << queries.size() * 1000.0 / elapsed << " queries/sec, " << searching * 1000.0 / queries.size() << "us search per route)";
+    std::cerr << "\n";
+}
+
+} // namespace batch
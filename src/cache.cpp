@@ -0,0 +1,207 @@
+#include "cache.h"
+#include "mapped.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <utility>
+
+namespace cache {
+
+static_assert(sizeof(Point) == 2 * sizeof(float), "the points section is used as the point array");
+
+namespace {
+
+size_t align(size_t bytes) {
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+/**
+ * @brief FNV-1a style hash, taken over 8-byte words (the tail is zero padded)
+ */
+uint64_t checksum(const char *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, std::min<size_t>(8, size - i));
+
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief byte offsets of the sections, relative to the end of the header
+ */
+struct Layout {
+    size_t points, roads, strings, end;
+
+    Layout(uint64_t points_count, uint64_t roads_count, uint64_t string_bytes) {
+        points = 0;
+        roads = align(points + points_count * 2 * sizeof(float));
+        strings = align(roads + roads_count * sizeof(RoadRecord));
+        end = align(strings + string_bytes);
+    }
+};
+
+enum Flag : uint8_t {
+    ROUNDABOUT = 1 << 0,
+    ONEWAY = 1 << 1,
+    BRIDGE = 1 << 2,
+    TOLL = 1 << 3,
+    LIT = 1 << 4,
+};
+
+} // namespace
+
+bool stamp(const std::string &source, uint64_t &size, int64_t &mtime) {
+    struct stat info;
+    if (stat(source.c_str(), &info) != 0)
+        return false;
+
+    size = info.st_size;
+    mtime = info.st_mtime;
+    return true;
+}
+
+bool write(const std::string &filename, const std::string &source, const Roads &roads) {
+    Header header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+
+    if (!stamp(source, header.source_size, header.source_mtime))
+        return false;
+
+    // intern the strings, the points are written as they are in memory
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> interned;
+
+    auto intern = [&](const std::string &str) -> uint32_t {
+        if (str.empty())
+            return 0;
+
+        auto it = interned.find(str);
+        if (it != interned.end())
+            return it->second;
+
+        const uint32_t offset = strings.size();
+        strings += str;
+        interned.emplace(str, offset);
+        return offset;
+    };
+
+    std::vector<RoadRecord> records;
+    records.reserve(roads.size());
+
+    for (const Road *road : roads) {
+        RoadRecord r = {};
+        r.id = road->id;
+        r.first_point = road->coordinates.offset();
+        r.point_count = road->coordinates.size();
+        r.name_offset = intern(road->name.str());
+        r.name_length = road->name.size();
+        r.ref_offset = intern(road->ref.str());
+        r.ref_length = road->ref.size();
+        r.maxspeed = road->maxspeed;
+        r.lanes = road->lanes;
+        r.highway = static_cast<uint8_t>(road->highway);
+        r.flags = (road->roundabout ? ROUNDABOUT : 0) | (road->oneway ? ONEWAY : 0) | (road->bridge ? BRIDGE : 0) | //
+                  (road->toll ? TOLL : 0) | (road->lit ? LIT : 0);
+
+        records.push_back(r);
+    }
+
+    header.points = roads.coordinates().size();
+    header.roads = records.size();
+    header.string_bytes = strings.size();
+
+    const Layout layout(header.points, header.roads, header.string_bytes);
+    std::vector<char> payload(layout.end, 0);
+
+    std::memcpy(payload.data() + layout.points, roads.coordinates().begin(), header.points * sizeof(Point));
+    std::memcpy(payload.data() + layout.roads, records.data(), records.size() * sizeof(RoadRecord));
+    std::memcpy(payload.data() + layout.strings, strings.data(), strings.size());
+
+    header.checksum = checksum(payload.data(), payload.size());
+
+    std::ofstream file(filename, std::ofstream::binary | std::ofstream::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(payload.data(), payload.size());
+
+    return static_cast<bool>(file);
+}
+
+bool read(const std::string &filename, const std::string &source, Roads &roads) {
+    std::unique_ptr<MappedFile> file(new MappedFile(filename));
+    if (!roads.empty() || !file->is_open() || file->size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (header.magic != MAGIC || header.version != VERSION)
+        return false;
+
+    // without the map itself there is nothing to be stale against
+    uint64_t size;
+    int64_t mtime;
+    if (stamp(source, size, mtime) && (size != header.source_size || mtime != header.source_mtime))
+        return false;
+
+    // guard the layout computation against absurd counts, before trusting them
+    const uint64_t available = file->size() - sizeof(Header);
+    if (header.points > available / 8 || header.roads > available / sizeof(RoadRecord) || header.string_bytes > available)
+        return false;
+
+    const Layout layout(header.points, header.roads, header.string_bytes);
+    const char *payload = file->data() + sizeof(Header);
+
+    if (layout.end != available || checksum(payload, layout.end) != header.checksum)
+        return false;
+
+    // the sections are read straight from the mapped file
+    const RoadRecord *records = reinterpret_cast<const RoadRecord *>(payload + layout.roads);
+    const char *strings = payload + layout.strings;
+
+    for (uint64_t i = 0; i < header.roads; i++) {
+        const RoadRecord &r = records[i];
+
+        if (uint64_t(r.first_point) + r.point_count > header.points ||                 //
+            uint64_t(r.name_offset) + r.name_length > header.string_bytes ||           //
+            uint64_t(r.ref_offset) + r.ref_length > header.string_bytes ||             //
+            r.highway > static_cast<uint8_t>(HighwayType::proposed))
+            return false;
+    }
+
+    // the roads are filled in one block, their points and names are the mapped sections themselves
+    std::vector<Road> loaded(header.roads);
+
+    for (uint64_t i = 0; i < header.roads; i++) {
+        const RoadRecord &r = records[i];
+
+        Road &road = loaded[i];
+        road.id = r.id;
+        road.coordinates = Coordinates(r.first_point, r.point_count);
+        road.name = Text(r.name_offset, r.name_length);
+        road.ref = Text(r.ref_offset, r.ref_length);
+        road.maxspeed = r.maxspeed;
+        road.lanes = r.lanes;
+        road.highway = static_cast<HighwayType>(r.highway);
+        road.roundabout = r.flags & ROUNDABOUT;
+        road.oneway = r.flags & ONEWAY;
+        road.bridge = r.flags & BRIDGE;
+        road.toll = r.flags & TOLL;
+        road.lit = r.flags & LIT;
+    }
+
+    roads.map(std::move(file), reinterpret_cast<const Point *>(payload + layout.points), header.points, strings, std::move(loaded));
+    return true;
+}
+
+} // namespace cache
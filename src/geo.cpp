@@ -1,40 +1,159 @@
 #include "geo.h"
 #include "util.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstring>
 #include <regex>
 #include <vector>
 
+namespace {
+
 /**
- * Use JS-style regex flavour, and case insensitive.
+ * @brief Forward-only cursor over one GeoJSON record
+ * It only knows as much JSON as the road records need: strings (keys and values) and coordinate arrays.
+ * Everything else (numbers, brackets, braces) is stepped over while looking for the next string.
  */
-const std::regex::flag_type flags = std::regex_constants::ECMAScript | std::regex_constants::icase;
+struct Scanner {
+    const char *p, *end;
+
+    /**
+     * @brief move to the next string, and get its contents (without the quotes, escapes are kept as is)
+     * @returns false at the end of the record
+     */
+    bool string(const char *&begin, const char *&stop) {
+        while (p < end && *p != '"')
+            p++;
+
+        if (p >= end)
+            return false;
+
+        begin = ++p;
+        while (p < end && *p != '"')
+            p += *p == '\\' ? 2 : 1;
+
+        stop = std::min(p, end);
+        p = std::min(p + 1, end);
+        return true;
+    }
+
+    /**
+     * @brief step over a ':' (and the whitespace around it)
+     * @returns true if the previous string was a key
+     */
+    bool colon() {
+        skip();
+        if (p >= end || *p != ':')
+            return false;
+
+        p++;
+        skip();
+        return true;
+    }
+
+    bool at(char c) const {
+        return p < end && *p == c;
+    }
+
+    void skip() {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+    }
+
+    /**
+     * @brief read the first innermost list of positions (`[[x,y],[x,y],...]`), at any depth of nesting
+     * Positions are read as longitude, latitude (GeoJSON order), extra dimensions are ignored.
+     */
+    void points(std::vector<Point> &points) {
+        int depth = 0;
+        const char *innermost = p;
+        while (at('[')) {
+            innermost = p++;
+            depth++;
+            skip();
+        }
+
+        // a single position is not a line
+        if (depth < 2)
+            return;
+
+        p = innermost;
+        while (at('[')) {
+            p++;
+            skip();
+
+            double x, y;
+            if (!Parser::number(p, end, x))
+                return;
+
+            skip();
+            if (!at(','))
+                return;
+
+            p++;
+            skip();
+            if (!Parser::number(p, end, y))
+                return;
+
+            while (p < end && *p != ']')
+                p++;
+
+            Point point;
+            point.x = x;
+            point.y = y;
+            points.push_back(point);
+
+            // past the position, on to the next one or the end of the list
+            p++;
+            skip();
+            if (!at(','))
+                return;
+
+            p++;
+            skip();
+        }
+    }
+};
 
-const std::regex id_r("\"id\":\"[^\\d]{0,1}(\\d+)\"", flags);
-extern const std::regex coordinate_r("\"coordinates\":\\[{0,2}(\\[\\[[\\[\\]\\d\\.,\\-]+\\])", flags);
+bool equals(const char *begin, const char *end, const char *literal) {
+    const size_t length = std::strlen(literal);
+    return static_cast<size_t>(end - begin) == length && std::memcmp(begin, literal, length) == 0;
+}
 
-// const std::regex coordinate_r("\"coordinates\":\\[{2}([\\[\\]\\d\\.\\-,]+)\\]{2}|\"coordinates\":([\\[\\]\\d\\.\\-,]+)", flags);
+bool iequals(const char *begin, const char *end, const char *literal) {
+    const size_t length = std::strlen(literal);
+    if (static_cast<size_t>(end - begin) != length)
+        return false;
 
-const std::regex name_r("\"name\":\"([^\"]+)\"", flags);
-const std::regex ref_r("\"ref\":\"([^\"]+)\"", flags);
+    for (size_t i = 0; i < length; i++)
+        if (std::tolower(static_cast<unsigned char>(begin[i])) != literal[i])
+            return false;
 
-// enums
-const std::regex highway_r("\"highway\":\"(motorway|trunk|primary|secondary|tertiary|unclassified|residential|service|living_street|road|motorway_link|trunk_link|primary_link|secondary_link|tertiary_link|pedestrian|footway|cycleway|path|"
-                           "bridleway|steps|track|busway|escape|raceway|construction|proposed)\"",
-                           flags);
+    return true;
+}
 
-// decimals
-const std::regex maxspeed_r("\"maxspeed\":\"(\\d+)\"", flags);
-const std::regex lanes_r("\"lanes\":\"(\\d+)\"", flags);
+/**
+ * @brief parse a string of decimal digits only
+ * @returns false if it is empty or has anything else in it
+ */
+template <typename T> bool digits(const char *begin, const char *end, T &out) {
+    if (begin == end)
+        return false;
 
-// logical
-const std::regex oneway_r("\"oneway\":\"yes\"", flags);
-const std::regex bridge_r("\"bridge\":\"yes\"", flags);
-const std::regex lit_r("\"toll\":\"yes\"", flags);
-const std::regex toll_r("\"lit\":\"yes\"", flags);
+    T value = 0;
+    for (const char *c = begin; c < end; c++) {
+        if (*c < '0' || *c > '9')
+            return false;
+
+        value = value * 10 + (*c - '0');
+    }
+
+    out = value;
+    return true;
+}
 
-// all multipolygon objects are basically an enclosed circle, handle them as roundabouts
-const std::regex roundabout_r("\"junction\":\"roundabout\"|\"type\":\"MultiPolygon\"", flags);
+} // namespace
 
 constexpr inline float dms2dec(int deg, int min, double sec, char dir) noexcept {
     return (dir == 'S' || dir == 'W' ? -1 : 1) * (deg + min / 60.0 + sec / 3600.0);
@@ -102,23 +221,94 @@ bool Point::within(const Point &p1, const Point &p2, const float distance_m) {
     return h <= h_limit;
 }
 
-void Road::parse(const std::string &line) {
-    this->coordinates = Parser::extract<std::vector<Point *>>(line, coordinate_r);
-
-    this->id = Parser::extract<unsigned int>(line, id_r);
-    this->ref = Parser::extract<std::string>(line, ref_r);
-    this->name = Parser::extract<std::string>(line, name_r);
-
-    this->highway = Parser::extract<HighwayType>(line, highway_r);
-
-    this->maxspeed = Parser::extract<int>(line, maxspeed_r, false, -1);
-    this->lanes = Parser::extract<int>(line, lanes_r, false, 1);
+void Road::parse(const std::string &line, std::vector<Point> &points, std::vector<char> &strings) {
+    parse(line.data(), line.data() + line.size(), points, strings);
+}
 
-    this->roundabout = Parser::match(line, roundabout_r);
-    this->lit = Parser::match(line, lit_r);
-    this->toll = Parser::match(line, toll_r);
-    this->oneway = Parser::match(line, oneway_r);
-    this->bridge = Parser::match(line, bridge_r);
+void Road::parse(const char *begin, const char *end, std::vector<Point> &points, std::vector<char> &strings) {
+    coordinates = Coordinates();
+
+    id = 0;
+    highway = HighwayType::unknown;
+    name = Text();
+    ref = Text();
+    maxspeed = -1;
+    lanes = 1;
+    roundabout = oneway = bridge = toll = lit = false;
+
+    bool has_id = false, has_highway = false, has_maxspeed = false, has_lanes = false;
+
+    Scanner scanner{begin, end};
+    const char *key, *key_end, *value, *value_end;
+
+    while (scanner.string(key, key_end)) {
+        // not followed by a colon: a value of a key we don't care about
+        if (!scanner.colon())
+            continue;
+
+        if (equals(key, key_end, "coordinates")) {
+            if (coordinates.empty()) {
+                const size_t first = points.size();
+                scanner.points(points);
+                coordinates = Coordinates(first, points.size() - first);
+            }
+
+            continue;
+        }
+
+        // the properties we use all have string values
+        if (!scanner.at('"') || !scanner.string(value, value_end))
+            continue;
+
+        if (equals(key, key_end, "id")) {
+            // osm ids are prefixed with the element type, eg. "w6115357"
+            if (!has_id && value < value_end)
+                has_id = digits(value + (*value < '0' || *value > '9'), value_end, id);
+
+        } else if (equals(key, key_end, "name")) {
+            if (name.empty()) {
+                name = Text(strings.size(), value_end - value);
+                strings.insert(strings.end(), value, value_end);
+            }
+
+        } else if (equals(key, key_end, "ref")) {
+            if (ref.empty()) {
+                ref = Text(strings.size(), value_end - value);
+                strings.insert(strings.end(), value, value_end);
+            }
+
+        } else if (equals(key, key_end, "highway")) {
+            if (!has_highway)
+                has_highway = parse_highway(value, value_end, highway);
+
+        } else if (equals(key, key_end, "maxspeed")) {
+            if (!has_maxspeed)
+                has_maxspeed = digits(value, value_end, maxspeed);
+
+        } else if (equals(key, key_end, "lanes")) {
+            if (!has_lanes)
+                has_lanes = digits(value, value_end, lanes);
+
+        } else if (equals(key, key_end, "oneway")) {
+            oneway |= iequals(value, value_end, "yes");
+
+        } else if (equals(key, key_end, "bridge")) {
+            bridge |= iequals(value, value_end, "yes");
+
+        } else if (equals(key, key_end, "lit")) {
+            lit |= iequals(value, value_end, "yes");
+
+        } else if (equals(key, key_end, "toll")) {
+            toll |= iequals(value, value_end, "yes");
+
+        } else if (equals(key, key_end, "junction")) {
+            roundabout |= iequals(value, value_end, "roundabout");
+
+        } else if (equals(key, key_end, "type")) {
+            // all multipolygon objects are basically an enclosed circle, handle them as roundabouts
+            roundabout |= iequals(value, value_end, "multipolygon");
+        }
+    }
 }
 
 float Road::visibility() {
@@ -167,62 +357,3 @@ float Road::rating() {
     }
 }
 
-void Road::write(std::ostream &os) const {
-    os.write(reinterpret_cast<const char *>(&id), sizeof(id));
-
-    size_t coordinates_size = coordinates.size();
-    os.write(reinterpret_cast<const char *>(&coordinates_size), sizeof(coordinates_size));
-    for (const Point *pt : coordinates) {
-        pt->write(os);
-    }
-
-    os.write(reinterpret_cast<const char *>(&highway), sizeof(highway));
-
-    size_t name_size = name.size();
-    os.write(reinterpret_cast<const char *>(&name_size), sizeof(name_size));
-    os.write(name.c_str(), name_size);
-
-    size_t ref_size = ref.size();
-    os.write(reinterpret_cast<const char *>(&ref_size), sizeof(ref_size));
-    os.write(ref.c_str(), ref_size);
-
-    os.write(reinterpret_cast<const char *>(&roundabout), sizeof(roundabout));
-    os.write(reinterpret_cast<const char *>(&oneway), sizeof(oneway));
-    os.write(reinterpret_cast<const char *>(&bridge), sizeof(bridge));
-    os.write(reinterpret_cast<const char *>(&maxspeed), sizeof(maxspeed));
-    os.write(reinterpret_cast<const char *>(&lanes), sizeof(lanes));
-    os.write(reinterpret_cast<const char *>(&toll), sizeof(toll));
-    os.write(reinterpret_cast<const char *>(&lit), sizeof(lit));
-}
-
-void Road::read(std::istream &is) {
-    is.read(reinterpret_cast<char *>(&id), sizeof(id));
-
-    size_t coordinate_size;
-    is.read(reinterpret_cast<char *>(&coordinate_size), sizeof(coordinate_size));
-    coordinates.resize(coordinate_size, 0);
-    for (size_t i = 0; i < coordinate_size; ++i) {
-        coordinates[i] = new Point();
-        coordinates[i]->read(is);
-    }
-
-    is.read(reinterpret_cast<char *>(&highway), sizeof(highway));
-
-    size_t name_size;
-    is.read(reinterpret_cast<char *>(&name_size), sizeof(name_size));
-    name.resize(name_size);
-    is.read(&name[0], name_size);
-
-    size_t ref_size;
-    is.read(reinterpret_cast<char *>(&ref_size), sizeof(ref_size));
-    ref.resize(ref_size);
-    is.read(&ref[0], ref_size);
-
-    is.read(reinterpret_cast<char *>(&roundabout), sizeof(roundabout));
-    is.read(reinterpret_cast<char *>(&oneway), sizeof(oneway));
-    is.read(reinterpret_cast<char *>(&bridge), sizeof(bridge));
-    is.read(reinterpret_cast<char *>(&maxspeed), sizeof(maxspeed));
-    is.read(reinterpret_cast<char *>(&lanes), sizeof(lanes));
-    is.read(reinterpret_cast<char *>(&toll), sizeof(toll));
-    is.read(reinterpret_cast<char *>(&lit), sizeof(lit));
-}
@@ -2,6 +2,7 @@
 #include "weights.h"
 
 #include <cassert>
+#include <cctype>
 #include <iomanip>
 #include <iostream>
 
@@ -61,28 +62,6 @@ std::istream &operator>>(std::istream &is, std::vector<Point> &points) {
   return is;
 }
 
-std::istream &operator>>(std::istream &is, std::vector<Point *> &points) {
-  static char c;
-
-  is >> c;
-  assert(c == '[');
-
-  while (true) {
-    Point *p = new Point();
-    is >> *p;
-
-    points.push_back(p);
-
-    is >> c;
-    assert(c == ',' || c == ']');
-
-    if (c == ']')
-      break;
-  }
-
-  return is;
-}
-
 std::ostream &operator<<(std::ostream &os, Point &point) {
   os << '[' << point.x << ',' << point.y << ']';
   return os;
@@ -132,6 +111,26 @@ HighwayType parse_highway(const std::string &str) {
   throw "invalid highway type!";
 }
 
+bool parse_highway(const char *begin, const char *end, HighwayType &highway_type) {
+  const size_t length = end - begin;
+
+  for (const auto &it : table) {
+    if (it.first.size() != length)
+      continue;
+
+    size_t i = 0;
+    while (i < length && std::tolower(static_cast<unsigned char>(begin[i])) == it.first[i])
+      i++;
+
+    if (i == length) {
+      highway_type = it.second;
+      return true;
+    }
+  }
+
+  return false;
+}
+
 std::istream &operator>>(std::istream &is, HighwayType &highway_type) {
   static std::string str;
   is >> str;
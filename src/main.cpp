@@ -1,9 +1,15 @@
 #include "algorithm.h"
+#include "batch.h"
+#include "chains.h"
 #include "cli.h"
+#include "components.h"
 #include "config.h" // IWYU pragma: keep
 #include "diagnostics.h"
 #include "lib.h"
+#include "matrix.h"
 #include "network.h"
+#include "query.h"
+#include "spatial.h"
 #include "util.h" // IWYU pragma: keep
 #include <iomanip>
 #include <ostream>
@@ -12,40 +18,6 @@
 
 #undef MEMTRACE
 
-Algorithm<Node> *algoselect(const Algorithm<Node>::Driver &driver, const DiGraph<Node> &graph, Weight<Node> *weight) {
-    switch (driver) {
-    case Algorithm<Node>::Driver::Dijkstra:
-        return new Dijkstra<Node>(graph, *weight);
-
-    case Algorithm<Node>::Driver::AStar:
-        return new AStar<Node>(graph, *weight, heuristic);
-
-    case Algorithm<Node>::Driver::BFS:
-        return new BFS<Node>(graph);
-
-    case Algorithm<Node>::Driver::DFS:
-        return new DFS<Node>(graph);
-
-    default:
-        throw std::invalid_argument("Invalid algorithm");
-    }
-}
-
-int closest(const DiGraph<Node> &graph, const Point &target) {
-    int min_idx = 0;
-    float min_dist = FMAX;
-
-    for (int i = 0; i < graph.size(); i++) {
-        const float dist = Point::haversine(target, graph.at(i));
-        if (dist < min_dist) {
-            min_dist = dist;
-            min_idx = i;
-        }
-    }
-
-    return min_idx;
-}
-
 int main(int argc, char *argv[]) {
 // support unicode on Windows
 #ifdef OS_WINDOWS
@@ -56,36 +28,178 @@ int main(int argc, char *argv[]) {
 #endif
 
     cli::Options options = cli::parse(argc, argv);
+    const bool batched = !options.batch.empty();
+
+    std::vector<batch::Query> queries;
+    if (batched) {
+        try {
+            queries = batch::read(options.batch);
+        } catch (const std::invalid_argument &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    const bool matrixed = !options.sources.empty();
+
+    std::vector<Point> sources, targets;
+    if (matrixed) {
+        try {
+            sources = matrix::read(options.sources);
+            targets = matrix::read(options.targets);
+        } catch (const std::invalid_argument &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    // in batch and matrix mode the standard output carries only the results, progress messages go to stderr
+    std::streambuf *stdout_buf = std::cout.rdbuf();
+    if (batched || matrixed)
+        std::cout.rdbuf(std::cerr.rdbuf());
 
     Bench load_b("Loading files");
-    std::vector<Road *> roads = loader::from_file(options.map);
+    Roads roads = loader::from_file(options.map);
     load_b.eval(true);
 
     Bench construct_b("Graph construction");
-    DiGraph<Node> graph = loader::construct(roads, options);
+    EdgeRoads edge_roads;
+    Components<Node> components;
+    DiGraph<Node> graph = loader::construct(roads, options, edge_roads, components);
+    const EdgeRoads *attribution = options.merge ? &edge_roads : nullptr;
     construct_b.eval(true);
 
+    // the components are used to reject the pairs without a route before searching
+    std::cout << components.count() << " strongly connected component(s), the largest has " << (components.count() > 0 ? components.size(components.largest()) : 0) //
+              << " of " << graph.size() << " vertices\n";
+
+    Bench index_b("Spatial index");
+    const KDTree<Node> index(graph);
+    index_b.eval(true);
+
+    Weight<Node> *weight = create(options.routing, options.coeffs);
+
+    // intersections carry only one of their roads, the edges are weighed on their own
+    if (options.merge)
+        weight = new OnEdgeRoads(weight, edge_roads);
+
+    // weigh every edge once per profile, the searches only look the weights up
+    Bench weights_b("Edge weights");
+    weight = loader::weights(graph, weight, options);
+    weights_b.eval(true);
+
+    // search on the junctions only, the routes are expanded back to the full graph
+    Chains<Node> *chains = nullptr;
+    ChainWeight<Node> *chain_weight = nullptr;
+
+    if (options.compress) {
+        Bench compress_b("Chain compression");
+        chains = new Chains<Node>(graph);
+        chain_weight = new ChainWeight<Node>(*chains, graph, *weight);
+        compress_b.eval(true);
+
+        std::cout << "compressed " << graph.edge_count() << " edges to " << chains->graph().edge_count() << " (" << chains->count() << " chains)\n";
+    }
+
+    const DiGraph<Node> &searched = chains != nullptr ? chains->graph() : graph;
+    Weight<Node> *search_weight = chain_weight != nullptr ? chain_weight : weight;
+
+    Hierarchy<Node> *hierarchy = nullptr;
+    if (options.algorithm == Algorithm<Node>::Driver::CH)
+        hierarchy = loader::hierarchy(searched, *search_weight, options);
+
+    // the matrix searches have no heuristic, only the single and the batched queries use the landmarks
+    Landmarks<Node> *landmarks = nullptr;
+    if (!matrixed && options.landmarks > 0 && (options.algorithm == Algorithm<Node>::Driver::AStar || options.algorithm == Algorithm<Node>::Driver::BiAStar))
+        landmarks = loader::landmarks(searched, *search_weight, options);
+
+    const Weight<Node> *estimate = landmarks != nullptr ? landmarks : static_cast<const Weight<Node> *>(&heuristic);
+
+    const batch::Factory select = [&]() -> Algorithm<Node> * {
+        Algorithm<Node> *algo = algoselect(options, searched, search_weight, estimate, hierarchy);
+        if (chains != nullptr)
+            algo = new Compressed<Node>(algo, *chains, *chain_weight);
+
+        return new Reachable<Node>(algo, searched, components);
+    };
+
+    if (matrixed) {
+        const std::vector<int> from = matrix::snap(sources, index, components), to = matrix::snap(targets, index, components);
+
+        // the backward searches of the targets are shared by every source
+        matrix::Buckets<Node> *buckets = nullptr;
+        if (hierarchy != nullptr) {
+            Bench buckets_b("Target buckets");
+            buckets = new matrix::Buckets<Node>(*hierarchy, graph, attribution, to);
+            buckets_b.eval(true);
+        }
+
+        const matrix::Factory create = [&]() -> matrix::Search * {
+            return matrix::select(options, searched, search_weight, components, attribution, hierarchy, buckets, to);
+        };
+
+        std::cout.rdbuf(stdout_buf);
+
+        matrix::run(from, to, create, options.threads, options.format, std::cout);
+
+        delete buckets;
+        delete landmarks;
+        delete hierarchy;
+        delete chain_weight;
+        delete chains;
+        delete weight;
+
+        return 0;
+    }
+
+    if (batched) {
+        std::cout.rdbuf(stdout_buf);
+
+        batch::run(queries, graph, attribution, index, components, select, options.threads, options.format, std::cout);
+
+        delete landmarks;
+        delete hierarchy;
+        delete chain_weight;
+        delete chains;
+        delete weight;
+
+        return 0;
+    }
+
+    Algorithm<Node> *algo = select();
+    algo->record(options.trace);
+
     int source, target;
 
-    // by default, choose two random points for source and target
+    // by default, choose two random points for source and target, both in the largest component so there is a route
     if (options.source == options.target) {
-        source = rand(0, graph.size());
-        target = rand(0, graph.size());
+        do
+            source = rand(0, graph.size());
+        while (components.component(source) != components.largest());
+
+        do
+            target = rand(0, graph.size());
+        while (components.component(target) != components.largest());
     } else {
-        source = closest(graph, options.source);
-        target = closest(graph, options.target);
+        source = snap(index, components, options.source);
+        target = snap(index, components, options.target);
     }
 
     if (source == target) {
         std::cerr << "source cannot be the same as the target!\n";
+
+        delete algo;
+        delete landmarks;
+        delete hierarchy;
+        delete chain_weight;
+        delete chains;
+        delete weight;
+
         return 1;
     }
 
     // ---
 
-    Weight<Node> *weight = create(options.routing, options.coeffs);
-    Algorithm<Node> *algo = algoselect(options.algorithm, graph, weight);
-
     Bench algo_b("Search algorithm");
     algo->run(source, target, true);
     std::vector<int> path = algo->reconstruct(source, target);
@@ -93,26 +207,19 @@ int main(int argc, char *argv[]) {
 
     // ---
 
-    float distance = 0, time = 0;
-
     // for (int i = 0; i < path.size(); i++)
     //     std::cout << path[i] << " ";
     // std::cout << "\n";
 
-    for (int i = 1; i < path.size(); i++) {
-        const Node from = graph.at(path[i - 1]), to = graph.at(path[i]);
-        const float s = Point::haversine(from, to);
-        const float v = std::max(30.f, (from.road->maxspeed + to.road->maxspeed) / 2.f) / 3.6f;
-
-        distance += s;
-        time += s / v;
-    }
+    const RouteInfo info = measure(graph, path, attribution);
 
     std::cout << std::setprecision(7);
 
     std::cout << "\nAlgorithm Diagnostics" << std::endl
               << "  Memory allocated by graph         " << std::setw(9) << graph.size_of() / pow2(1024.f) << " MB" << std::endl
               << "  Memory allocated by algorithm     " << std::setw(9) << algo->size_of() / pow2(1024.f) << " MB" << std::endl
+              << "  Memory allocated by trace         " << std::setw(9) << algo->trace.size_of() / pow2(1024.f) << " MB" << std::endl
+              << "  Counters                         " << std::setw(13) << (Counter::enabled ? "instrumented" : "compiled out") << std::endl
               << "  Total steps                      " << std::setw(13) << algo->steps << "" << std::endl
               << "  Total comparisons                " << std::setw(13) << algo->comparisons << "" << std::endl
               << "  Total memory operations          " << std::setw(13) << algo->memops << "" << std::endl
@@ -120,14 +227,18 @@ int main(int argc, char *argv[]) {
 
     std::cout << "Route Information" << std::endl
               << "  Point-to-Point distance  " << std::setw(8) << Point::haversine(graph.at(target), graph.at(source)) / 1000 << " km" << std::endl
-              << "  Route distance           " << std::setw(8) << distance / 1000.f << " km" << std::endl
-              << "  Estimated time               " << fmt(time) << std::endl
+              << "  Route distance           " << std::setw(8) << info.distance / 1000.f << " km" << std::endl
+              << "  Estimated time               " << fmt(info.time) << std::endl
               << std::endl;
 
-    Network network = Network(graph, roads);
+    Network network = Network(graph, roads, attribution);
     network.run(*algo, path, target, source, options);
 
     delete algo;
+    delete landmarks;
+    delete hierarchy;
+    delete chain_weight;
+    delete chains;
     delete weight;
 
     return 0;
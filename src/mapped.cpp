@@ -0,0 +1,59 @@
+#include "mapped.h"
+#include "config.h" // IWYU pragma: keep
+
+#include <fstream>
+
+#ifdef OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &filename) {
+#ifdef OS_LINUX
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            length = info.st_size;
+            opened = true;
+
+            if (length > 0) {
+                void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (address != MAP_FAILED) {
+                    madvise(address, length, MADV_SEQUENTIAL);
+                    bytes = static_cast<const char *>(address);
+                    mapped = true;
+                } else
+                    opened = false; // try reading it instead
+            }
+        }
+
+        close(fd);
+    }
+
+    if (opened)
+        return;
+#endif
+
+    std::ifstream file(filename, std::ifstream::binary | std::ifstream::ate);
+    if (!file.is_open())
+        return;
+
+    buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), buffer.size());
+
+    bytes = buffer.data();
+    length = buffer.size();
+    opened = static_cast<bool>(file);
+}
+
+MappedFile::~MappedFile() {
+#ifdef OS_LINUX
+    if (mapped)
+        munmap(const_cast<char *>(bytes), length);
+#endif
+}
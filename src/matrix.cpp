@@ -0,0 +1,225 @@
+#include "matrix.h"
+#include "query.h"
+
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace matrix {
+
+std::vector<Point> read(const std::string &filename) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::invalid_argument("failed to open point file '" + filename + "'");
+
+    std::vector<Point> points;
+    std::string line;
+
+    for (int n = 1; std::getline(file, line); n++) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        // header, eg. "lat,lon"
+        if (points.empty() && std::isalpha(static_cast<unsigned char>(line[0])))
+            continue;
+
+        try {
+            points.push_back(Point::parse(line));
+        } catch (const std::invalid_argument &e) {
+            throw std::invalid_argument(filename + ":" + std::to_string(n) + ": invalid point '" + line + "' (" + e.what() + ")");
+        }
+    }
+
+    return points;
+}
+
+std::vector<int> snap(const std::vector<Point> &points, const KDTree<Node> &index, const Components<Node> &components) {
+    std::vector<int> vertices;
+    vertices.reserve(points.size());
+
+    for (const Point &p : points)
+        vertices.push_back(::snap(index, components, p));
+
+    return vertices;
+}
+
+namespace {
+
+/**
+ * @brief one-to-many Dijkstra specialized for the type of the weight
+ */
+template <typename W>
+Search *dijkstra(const cli::Options &options, const DiGraph<Node> &graph, const W &weight, const Components<Node> &components, const EdgeRoads *roads, const std::vector<int> &targets) {
+    if (options.heap == HeapType::Dary)
+        return new OneToMany<Node, DaryHeap<4>, W>(graph, weight, components, roads, targets);
+
+    if (options.heap == HeapType::Radix)
+        return new OneToMany<Node, RadixHeap, W>(graph, weight, components, roads, targets);
+
+    return new OneToMany<Node, LazyHeap, W>(graph, weight, components, roads, targets);
+}
+
+/**
+ * @brief number of sources a worker claims at once
+ */
+const size_t CHUNK = 4;
+
+/**
+ * @brief the matrices, row-major, NaN where there is no route
+ */
+struct Table {
+    size_t rows, cols;
+    std::vector<float> distance, time;
+
+    Table(size_t rows, size_t cols)
+        : rows(rows), cols(cols), //
+          distance(rows * cols, std::numeric_limits<float>::quiet_NaN()), time(rows * cols, std::numeric_limits<float>::quiet_NaN()) {}
+};
+
+/**
+ * @brief route rows until there are none left, claiming them in chunks through `next`
+ */
+void work(const std::vector<int> &sources, Search &search, std::atomic<size_t> &next, Table &table, uint64_t &steps) {
+    for (size_t begin = next.fetch_add(CHUNK); begin < sources.size(); begin = next.fetch_add(CHUNK)) {
+        const size_t end = std::min(begin + CHUNK, sources.size());
+
+        for (size_t i = begin; i < end; i++) {
+            search.run(sources[i]);
+
+            for (size_t j = 0; j < table.cols; j++) {
+                RouteInfo info;
+                if (!search.route(j, info))
+                    continue;
+
+                table.distance[i * table.cols + j] = info.distance;
+                table.time[i * table.cols + j] = info.time;
+            }
+        }
+    }
+
+    steps = search.steps;
+}
+
+void write(const Table &table, cli::Format format, std::ostream &os) {
+    if (format == cli::Format::Binary) {
+        const uint32_t header[] = {MAGIC, VERSION, (uint32_t)table.rows, (uint32_t)table.cols};
+
+        os.write(reinterpret_cast<const char *>(header), sizeof(header));
+        os.write(reinterpret_cast<const char *>(table.distance.data()), table.distance.size() * sizeof(float));
+        os.write(reinterpret_cast<const char *>(table.time.data()), table.time.size() * sizeof(float));
+        os.flush();
+        return;
+    }
+
+    const bool json = format == cli::Format::JSON;
+    os << std::fixed << std::setprecision(3);
+
+    auto matrix = [&](const std::vector<float> &values) {
+        for (size_t i = 0; i < table.rows; i++) {
+            if (json)
+                os << "    [";
+
+            for (size_t j = 0; j < table.cols; j++) {
+                const float value = values[i * table.cols + j];
+
+                if (j > 0)
+                    os << (json ? ", " : ",");
+
+                if (!std::isnan(value))
+                    os << value;
+                else if (json)
+                    os << "null";
+            }
+
+            if (json)
+                os << (i + 1 < table.rows ? "],\n" : "]\n");
+            else
+                os << '\n';
+        }
+    };
+
+    if (json) {
+        os << "{\n  \"sources\": " << table.rows << ",\n  \"targets\": " << table.cols << ",\n";
+        os << "  \"distance\": [\n";
+        matrix(table.distance);
+        os << "  ],\n  \"time\": [\n";
+        matrix(table.time);
+        os << "  ]\n}\n";
+    } else {
+        os << "# distance (m), " << table.rows << " sources x " << table.cols << " targets\n";
+        matrix(table.distance);
+        os << "# time (s)\n";
+        matrix(table.time);
+    }
+
+    os.flush();
+}
+
+} // namespace
+
+Search *select(const cli::Options &options, const DiGraph<Node> &graph, const Weight<Node> *weight, const Components<Node> &components, const EdgeRoads *roads, //
+               const Hierarchy<Node> *hierarchy, const Buckets<Node> *buckets, const std::vector<int> &targets) {
+    if (options.algorithm == Algorithm<Node>::Driver::CH) {
+        if (hierarchy == nullptr || buckets == nullptr)
+            throw std::invalid_argument("Contraction hierarchy is not loaded");
+
+        return new ManyToMany<Node>(*hierarchy, *buckets, graph, roads, targets);
+    }
+
+    // the materialized weights main sets up are inlined into the search, like in `algoselect`
+    if (const EdgeWeights *materialized = dynamic_cast<const EdgeWeights *>(weight))
+        return dijkstra(options, graph, *materialized, components, roads, targets);
+
+    return dijkstra<Weight<Node>>(options, graph, *weight, components, roads, targets);
+}
+
+void run(const std::vector<int> &sources, const std::vector<int> &targets, const Factory &create, unsigned int threads, cli::Format format, std::ostream &os) {
+    threads = std::max(1u, std::min<unsigned int>(threads, (sources.size() + CHUNK - 1) / CHUNK));
+
+    Table table(sources.size(), targets.size());
+    std::atomic<size_t> next(0);
+
+    // every worker owns its search, the graph, the weights and the buckets are only read
+    std::vector<std::unique_ptr<Search>> searches;
+    for (unsigned int t = 0; t < threads; t++)
+        searches.emplace_back(create());
+
+    std::vector<uint64_t> steps(threads, 0);
+    Bench total("Matrix");
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; t++)
+        workers.emplace_back(work, std::cref(sources), std::ref(*searches[t]), std::ref(next), std::ref(table), std::ref(steps[t]));
+
+    work(sources, *searches[0], next, table, steps[0]);
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    const double elapsed = total.elapsed(true);
+
+    write(table, format, os);
+
+    // keep stdout machine readable, the summary goes to stderr
+    uint64_t total_steps = 0;
+    for (uint64_t s : steps)
+        total_steps += s;
+
+    const size_t pairs = sources.size() * targets.size();
+    std::cerr << "Computed a " << sources.size() << " x " << targets.size() << " matrix in " << elapsed << "ms on " << threads << " thread(s)" << (Counter::enabled ? "" : ", counters compiled out");
+    if (pairs > 0)
+        std::cerr << " (" << pairs * 1000.0 / elapsed << " pairs/sec, " << elapsed * 1000.0 / sources.size() << "us per source, " << total_steps << " steps)";
+    std::cerr << "\n";
+}
+
+} // namespace matrix
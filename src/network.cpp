@@ -1,12 +1,22 @@
 #include "network.h"
+#include "cache.h"
 #include "cli.h"
+#include "components.h"
 #include "diagnostics.h"
 #include "lib.h"
+#include "mapped.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <sys/stat.h>
+#include <thread>
+#include <utility>
 #include <vector>
 
 glm::vec3 motor2color(const HighwayType highway) {
@@ -57,11 +67,17 @@ void Network::setup() {
     BBox bbox = BBox::max();
 
     for (int from = 0; from < graph.vtx().size(); from++) {
-        for (int to : graph.adjacent(from)) {
+        for (int to : graph.neighbors(from)) {
             if (from < to) {
                 const Node &node_to = graph.at(to), node_from = graph.at(from);
+
+                Road *road = node_from.road;
+                const int edge = edge_roads != nullptr ? edge_roads->find(from, to) : -1;
+                if (edge >= 0)
+                    road = (*edge_roads)[edge];
+
                 bbox.include(node_to);
-                map.geo_roads.add(transform(node_from), transform(node_to), motor2color(node_from.road->highway), node_from.road->visibility());
+                map.geo_roads.add(transform(node_from), transform(node_to), motor2color(road->highway), road->visibility());
             }
         }
     }
@@ -76,19 +92,16 @@ void Network::setup() {
  * @brief trace down the visited nodes
  * @returns true if the trace has been consumed
  */
-bool Network::trace(Algorithm<Node>::Trace &trace, const int spread_rate) {
-    if (trace.consumed())
+bool Network::trace(const Algorithm<Node>::Trace &trace, const int spread_rate) {
+    if (traced >= trace.size())
         return true;
 
-    for (int i = 0; i < spread_rate; i++) {
-        while (trace.has_next()) {
-            const auto p1 = transform(graph.at(trace.current()));
-            const auto p2 = transform(graph.at(trace.next()));
-
-            map.discovered.add(p1, p2, color::ORANGERED, graph.at(trace.current()).road->rating() * 2);
-        }
+    for (int i = 0; i < spread_rate && traced < trace.size(); i++) {
+        const Algorithm<Node>::Trace::Segment segment = trace[traced++];
+        const Node &parent = graph.at(segment.parent());
 
-        trace.skip();
+        for (int child : segment)
+            map.discovered.add(transform(parent), transform(graph.at(child)), color::ORANGERED, parent.road->rating() * 2);
     }
 
     map.discovered.update();
@@ -123,7 +136,7 @@ void Network::run(Algorithm<Node> &algo, const std::vector<int> &path, const int
     map.points.update();
 
     // references for capture
-    Algorithm<Node>::Trace &trace = algo.trace;
+    const Algorithm<Node>::Trace &trace = algo.trace;
     const int &trace_rate = options.trace_rate;
     const int &route_rate = options.route_rate;
 
@@ -160,8 +173,34 @@ bool exists(const std::string &filename) {
     return (stat(filename.c_str(), &buffer) == 0);
 }
 
-void parse(const std::string &filename, std::vector<Road *> &roads) {
-    std::ifstream file(filename, std::ifstream::binary);
+/**
+ * @brief parse every line of [begin, end) into a road, the coordinates go to `points`, the names to `strings`
+ */
+void parse_chunk(const char *begin, const char *end, std::vector<Road> &roads, std::vector<Point> &points, std::vector<char> &strings) {
+    while (begin < end) {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        const char *stop = newline != nullptr ? newline : end;
+
+        const char *last = stop;
+        if (last > begin && last[-1] == '\r')
+            last--;
+
+        if (last > begin) {
+            roads.emplace_back();
+            roads.back().parse(begin, last, points, strings);
+        }
+
+        begin = stop + 1;
+    }
+}
+
+/**
+ * @brief below this size the file is parsed on the calling thread
+ */
+static const size_t PARALLEL_THRESHOLD = 1 << 20;
+
+void parse(const std::string &filename, Roads &roads, unsigned int threads) {
+    const MappedFile file(filename);
     if (!file.is_open()) {
         std::cerr << "failed to open '" << filename << "'\n";
         exit(EXIT_FAILURE);
@@ -169,61 +208,400 @@ void parse(const std::string &filename, std::vector<Road *> &roads) {
 
     Bench b;
 
-    static std::string line;
-    while (std::getline(file, line)) {
-        Road *road = new Road;
-        road->parse(line);
-        roads.push_back(road);
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
 
-        // user feedback
-        if (roads.size() % 1000 == 0) {
-            auto el = b.elapsed(true);
-            std::cout << "read " << std::setw(6) << roads.size() << " records in " << std::setprecision(6) << el << "ms \tbatch average: " << std::setprecision(6) << roads.size() / el * 1000 << " records/sec\n";
-        }
+    if (file.size() < PARALLEL_THRESHOLD)
+        threads = 1;
+
+    // a few chunks per thread, so that threads finishing early can pick up more work;
+    // every chunk starts right after a newline (or at the beginning of the file)
+    const size_t count = threads == 1 ? 1 : threads * 4;
+    std::vector<const char *> bounds(1, file.begin());
+    for (size_t i = 1; i < count; i++) {
+        const char *at = std::max(bounds.back(), file.begin() + file.size() * i / count);
+        const char *newline = static_cast<const char *>(std::memchr(at, '\n', file.end() - at));
+
+        if (newline == nullptr)
+            break;
+
+        bounds.push_back(newline + 1);
+    }
+    bounds.push_back(file.end());
+
+    // every chunk collects its roads, and their coordinates and names, in arrays of its own
+    std::vector<std::vector<Road>> chunks(bounds.size() - 1);
+    std::vector<std::vector<Point>> points(chunks.size());
+    std::vector<std::vector<char>> strings(chunks.size());
+    std::atomic<size_t> next(0);
+
+    auto work = [&]() {
+        for (size_t i = next++; i < chunks.size(); i = next++)
+            parse_chunk(bounds[i], bounds[i + 1], chunks[i], points[i], strings[i]);
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < std::min<size_t>(threads, chunks.size()); t++)
+        workers.emplace_back(work);
+
+    work();
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    // merge in file order
+    size_t road_count = roads.size(), point_count = roads.coordinates().size(), string_count = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        road_count += chunks[i].size();
+        point_count += points[i].size();
+        string_count += strings[i].size();
     }
 
-    file.close();
+    roads.reserve(road_count, point_count, string_count);
+    for (size_t i = 0; i < chunks.size(); i++)
+        roads.append(std::move(chunks[i]), std::move(points[i]), std::move(strings[i]));
+
+    const auto el = b.elapsed(true);
+    std::cout << "parsed " << roads.size() << " records in " << std::setprecision(6) << el << "ms (" << roads.size() / el * 1000 << " records/sec, " //
+              << std::min<size_t>(threads, chunks.size()) << " thread(s))\n";
 }
 
-std::vector<Road *> from_file(const std::string &filename, bool use_cache) {
+Roads from_file(const std::string &filename, bool use_cache, unsigned int threads) {
     Bench t;
 
     const std::string cached_name = filename + ".cache.bin";
 
-    std::vector<Road *> roads;
+    Roads roads;
 
     if (use_cache && exists(cached_name)) {
-        Serializable::read(cached_name.c_str(), roads);
-
-    } else {
-        parse(filename, roads);
+        if (cache::read(cached_name, filename, roads))
+            return roads;
 
-        if (use_cache) {
-            Serializable::write(cached_name.c_str(), roads);
-        }
+        std::cout << "'" << cached_name << "' is stale or corrupt, parsing the map\n";
     }
 
+    parse(filename, roads, threads);
+
+    if (use_cache && !cache::write(cached_name, filename, roads))
+        std::cerr << "failed to write '" << cached_name << "'\n";
+
     return roads;
 }
 
 //
 
-DiGraph<Node> construct_graph(std::vector<Vertex<Node>> &vlist, const std::vector<unsigned int> &segments, const cli::Options &options) {
-    if (options.graph == DiGraph<Node>::Driver::Matrix) {
-        std::cout << "You appear to have chosen the adjacency matrix graph driver. "
-                     "This data structure is highly inefficient memory-wise.\n"
-                  << "The graph contains " << vlist.size() << " vertices, and the matrix size is about to be: " << vlist.size() * vlist.size() * sizeof(int) / 1024.f / 1024.f << " MBs\n"
-                  << "Do you wish to continue? [yn] ";
-
-        char c;
-        std::cin >> c;
-
-        if (c != 'y') {
-            std::cerr << "aborted\n";
-            exit(EXIT_FAILURE);
+namespace {
+
+/**
+ * @brief ask for confirmation before allocating an adjacency matrix
+ */
+void confirm_matrix(size_t vertices) {
+    std::cout << "You appear to have chosen the adjacency matrix graph driver. "
+                 "This data structure is highly inefficient memory-wise.\n"
+              << "The graph contains " << vertices << " vertices, and the matrix size is about to be: " << vertices * vertices * sizeof(int) / 1024.f / 1024.f << " MBs\n"
+              << "Do you wish to continue? [yn] ";
+
+    char c;
+    std::cin >> c;
+
+    if (c != 'y') {
+        std::cerr << "aborted\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+const char *driver_name(DiGraph<Node>::Driver driver) {
+    switch (driver) {
+    case DiGraph<Node>::Driver::Matrix:
+        return "matrix";
+    case DiGraph<Node>::Driver::List:
+        return "list";
+    case DiGraph<Node>::Driver::CSR:
+        return "csr";
+    default:
+        throw std::invalid_argument("Invalid graph driver");
+    }
+}
+
+/**
+ * @brief The constructed graph, as saved next to the map
+ * Every vertex is stored as the (road, point) index pair it was made of, the edges in compressed sparse row form.
+ */
+struct GraphFile : Serializable {
+    static const uint32_t MAGIC = 0x48505247; // "GRPH"
+    static const uint32_t VERSION = 4;
+
+    enum Flag : uint32_t {
+        MERGED = 1 << 0,
+        PRUNED = 1 << 1,
+    };
+
+    /**
+     * @brief size and modification time of the map the graph was made of
+     */
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+
+    uint64_t roads = 0;
+
+    /**
+     * @brief construction options the graph was built with
+     */
+    uint32_t flags = 0;
+
+    std::vector<uint32_t> road, point;
+    std::vector<int> offsets, targets;
+
+    /**
+     * @brief road of every edge, in the order of the targets (merged graphs only)
+     */
+    std::vector<uint32_t> edge_road;
+
+    /**
+     * @brief strongly connected component of every vertex
+     */
+    std::vector<int> component;
+
+    bool valid = false;
+
+    void write(std::ostream &os) const override {
+        const uint32_t magic = MAGIC, version = VERSION;
+        os.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+        os.write(reinterpret_cast<const char *>(&version), sizeof(version));
+        os.write(reinterpret_cast<const char *>(&source_size), sizeof(source_size));
+        os.write(reinterpret_cast<const char *>(&source_mtime), sizeof(source_mtime));
+        os.write(reinterpret_cast<const char *>(&roads), sizeof(roads));
+        os.write(reinterpret_cast<const char *>(&flags), sizeof(flags));
+
+        write_pod(os, road);
+        write_pod(os, point);
+        write_pod(os, offsets);
+        write_pod(os, targets);
+        write_pod(os, edge_road);
+        write_pod(os, component);
+    }
+
+    /**
+     * @note `valid` is only set if the file is complete and self-consistent
+     */
+    void read(std::istream &is) override {
+        uint32_t magic = 0, version = 0;
+        is.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        is.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+        valid = false;
+        if (magic != MAGIC || version != VERSION)
+            return;
+
+        is.read(reinterpret_cast<char *>(&source_size), sizeof(source_size));
+        is.read(reinterpret_cast<char *>(&source_mtime), sizeof(source_mtime));
+        is.read(reinterpret_cast<char *>(&roads), sizeof(roads));
+        is.read(reinterpret_cast<char *>(&flags), sizeof(flags));
+
+        read_pod(is, road);
+        read_pod(is, point);
+        read_pod(is, offsets);
+        read_pod(is, targets);
+        read_pod(is, edge_road);
+        read_pod(is, component);
+
+        if (!is || road.size() != point.size() || offsets.size() != road.size() + 1 || offsets.front() != 0 || offsets.back() != (int)targets.size())
+            return;
+
+        if (edge_road.size() != ((flags & MERGED) ? targets.size() : 0))
+            return;
+
+        if (component.size() != road.size())
+            return;
+
+        for (size_t v = 0; v < road.size(); v++)
+            if (offsets[v] > offsets[v + 1])
+                return;
+
+        for (int to : targets)
+            if (to < 0 || to >= (int)road.size())
+                return;
+
+        for (int c : component)
+            if (c < 0 || c >= (int)road.size())
+                return;
+
+        valid = true;
+    }
+
+    /**
+     * @returns true if the file was made of this version of the map with the same options, and its vertices exist among the roads
+     */
+    bool matches(const std::string &map, const Roads &roads, uint32_t flags) const {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+
+        if (!valid || this->roads != roads.size() || this->flags != flags)
+            return false;
+
+        if (cache::stamp(map, size, mtime) && (size != source_size || mtime != source_mtime))
+            return false;
+
+        for (size_t v = 0; v < road.size(); v++)
+            if (road[v] >= roads.size() || point[v] >= roads[road[v]]->coordinates.size())
+                return false;
+
+        for (uint32_t r : edge_road)
+            if (r >= roads.size())
+                return false;
+
+        return true;
+    }
+};
+
+/**
+ * @brief common beginning of the names of the files precomputed for the map, with the construction options
+ */
+std::string stem(const cli::Options &options) {
+    return options.map + (options.merge ? ".merged" : "") + (options.prune ? ".pruned" : "");
+}
+
+/**
+ * @brief below this many points the locations are matched on the calling thread
+ */
+static const size_t MATCH_THRESHOLD = 1 << 16;
+
+/**
+ * @brief Find the coincident points: the ones with the same fixed-point key
+ * Every point is looked up in an open addressing table of the keys seen so far, in the order of `points`, so the
+ * result doesn't depend on the number of threads. The threads share the keys by their hash: each one scans every
+ * point, but only handles the locations of its own share, in a table of its own.
+ * @returns for every point, the previous point of the same location, or itself for the first one
+ */
+std::vector<uint32_t> coincident(const std::vector<const Point *> &points) {
+    const size_t n = points.size();
+
+    std::vector<uint64_t> keys(n), hashes(n);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = points[i]->key();
+
+        // splitmix64 finalizer, the keys of neighbouring points differ only in their low bits
+        uint64_t h = keys[i];
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        hashes[i] = h ^ (h >> 31);
+    }
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    if (n < MATCH_THRESHOLD)
+        threads = 1;
+
+    std::vector<uint32_t> previous(n);
+
+    auto match = [&](unsigned int share) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++)
+            count += (hashes[i] >> 32) % threads == share;
+
+        // at most half full
+        size_t capacity = 16;
+        while (capacity < 2 * count)
+            capacity *= 2;
+
+        const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+        std::vector<uint64_t> table(capacity);
+        std::vector<uint32_t> last(capacity, EMPTY);
+
+        for (size_t i = 0; i < n; i++) {
+            if ((hashes[i] >> 32) % threads != share)
+                continue;
+
+            size_t slot = hashes[i] & (capacity - 1);
+            while (last[slot] != EMPTY && table[slot] != keys[i])
+                slot = (slot + 1) & (capacity - 1);
+
+            previous[i] = last[slot] == EMPTY ? i : last[slot];
+
+            table[slot] = keys[i];
+            last[slot] = i;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int share = 1; share < threads; share++)
+        workers.emplace_back(match, share);
+
+    match(0);
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    return previous;
+}
+
+/**
+ * @brief Keep only the largest strongly connected component of the graph, its vertices keep their order
+ * @param file the (road, point) pairs of the vertices and the roads of the edges are kept for the remaining ones
+ * @param edge_roads rebuilt for the remaining edges, if the points are merged
+ */
+DiGraph<Node> prune(const DiGraph<Node> &graph, const Roads &roads, const cli::Options &options, GraphFile &file, EdgeRoads &edge_roads) {
+    const Components<Node> components(graph);
+    const int largest = components.largest();
+
+    std::vector<int> renumbered(graph.size(), -1);
+    std::vector<Vertex<Node>> vlist;
+    std::vector<uint32_t> road, point;
+
+    for (size_t v = 0; v < graph.size(); v++) {
+        if (components.component(v) != largest)
+            continue;
+
+        renumbered[v] = vlist.size();
+        vlist.push_back(Vertex<Node>(graph.at(v), vlist.size()));
+        road.push_back(file.road[v]);
+        point.push_back(file.point[v]);
+    }
+
+    // the edges of a component stay within it, the others are dropped; edge_road follows the row by row numbering
+    std::vector<int> offsets(1, 0), targets;
+    std::vector<uint32_t> edge_road;
+
+    for (size_t v = 0, e = 0; v < graph.size(); v++) {
+        for (int to : graph.neighbors(v)) {
+            const size_t edge = e++;
+            if (renumbered[v] < 0 || renumbered[to] < 0)
+                continue;
+
+            targets.push_back(renumbered[to]);
+            if (!file.edge_road.empty())
+                edge_road.push_back(file.edge_road[edge]);
         }
+
+        if (renumbered[v] >= 0)
+            offsets.push_back(targets.size());
+    }
+
+    std::cout << "pruned to the largest strongly connected component: " << vlist.size() << " of " << graph.size() << " vertices (" //
+              << components.count() << " components)\n";
+
+    DiGraph<Node> pruned(vlist, options.graph);
+    pruned.assign(offsets, targets);
+
+    if (options.merge) {
+        std::vector<Road *> values;
+        values.reserve(edge_road.size());
+
+        for (uint32_t r : edge_road)
+            values.push_back(roads[r]);
+
+        edge_roads = EdgeRoads(offsets, targets, values);
     }
 
+    file.road.swap(road);
+    file.point.swap(point);
+    file.edge_road.swap(edge_road);
+
+    return pruned;
+}
+
+} // namespace
+
+DiGraph<Node> construct_graph(std::vector<Vertex<Node>> &vlist, const std::vector<unsigned int> &segments, const cli::Options &options) {
     DiGraph<Node> graph(vlist, options.graph);
 
     // STEP 1: connect segments
@@ -250,80 +628,297 @@ DiGraph<Node> construct_graph(std::vector<Vertex<Node>> &vlist, const std::vecto
     }
 
     // STEP 2: connect overlapping roads
-    // concept: make the points hashable, keep track of the Nodes sharing the same
-    // Points using a hashmap. This way only one iteration is required over the
-    // vertex list (note: hashing might have minimal inaccuracy, luckily it's
-    // irrelevant for out purpose)
+    // points of the same location have the same fixed-point key, every point is linked to the previous one of its
+    // location, so they form a chain
+    std::vector<const Point *> points;
+    points.reserve(vlist.size());
+    for (const Vertex<Node> &v : vlist)
+        points.push_back(v.data.loc);
+
+    const std::vector<uint32_t> previous = coincident(points);
+
+    for (size_t i = 0; i < previous.size(); i++) {
+        // TOFIX:
+        // check for overpasses (either connecting 2 bridge components or
+        // non-bridge ones), coincident points of a bridge and the road under
+        // it are linked as well
+        if (previous[i] != i)
+            graph.b_edge(previous[i], i);
+    }
+
+    graph.freeze();
+    return graph;
+}
+
+/**
+ * @brief Build the graph with one vertex per point of every road, coincident points are linked by edges
+ * @param file receives the (road, point) pair of every vertex
+ */
+DiGraph<Node> construct_split(const Roads &roads, const cli::Options &options, GraphFile &file) {
+    std::vector<unsigned int> segments;
+    std::vector<Vertex<Node>> vlist;
+    vlist.reserve(roads.coordinates().size());
+
+    for (size_t r = 0; r < roads.size(); r++) {
+        Road *road = roads[r];
+
+        for (size_t k = 0; k < road->coordinates.size(); k++) {
+            vlist.push_back(Vertex<Node>(Node(road, &road->coordinates[k]), vlist.size()));
+            file.road.push_back(r);
+            file.point.push_back(k);
+        }
+
+        if (vlist.size() > 0)
+            segments.push_back(vlist.size());
+    }
+
+    if (options.graph == DiGraph<Node>::Driver::Matrix)
+        confirm_matrix(vlist.size());
 
-    std::unordered_map<size_t, std::vector<Vertex<Node> *>> point_map;
+    return construct_graph(vlist, segments, options);
+}
+
+/**
+ * @brief an edge to add, along with the road it belongs to
+ */
+struct Link {
+    int from, to;
+    uint32_t road;
+};
 
-    for (int i = 0; i < vlist.size(); i++) {
-        const size_t key = vlist[i].data.loc->hash();
+/**
+ * @brief Build the graph with one vertex per location
+ * Points of different roads (or of the same road, eg. closed ways) at exactly the same location, ie. with the same
+ * 1e-7 degree key (see `Point::key`), become a single vertex, so intersections need no linking edges.
+ * Every edge remembers the road it was made of.
+ * @param file receives the (road, point) pair of every vertex and the road of every edge
+ */
+DiGraph<Node> construct_merged(const Roads &roads, const cli::Options &options, GraphFile &file, EdgeRoads &edge_roads) {
+    std::vector<Vertex<Node>> vlist;
 
-        if (point_map.count(key) == 0)
-            point_map.insert({key, std::vector<Vertex<Node> *>(1, &vlist[i])});
-        else
-            point_map[key].push_back(&vlist[i]);
+    // every point, road after road
+    std::vector<const Point *> points;
+    std::vector<std::pair<uint32_t, uint32_t>> origin;
+    points.reserve(roads.coordinates().size());
+    origin.reserve(roads.coordinates().size());
+
+    for (size_t r = 0; r < roads.size(); r++) {
+        for (size_t k = 0; k < roads[r]->coordinates.size(); k++) {
+            points.push_back(&roads[r]->coordinates[k]);
+            origin.emplace_back(r, k);
+        }
     }
 
-    for (auto &p : point_map) {
-        for (int i = 1; i < p.second.size(); i++) {
-            // sanity check the distance
-            if (Point::within(p.second[i - 1]->data, p.second[i]->data, 1.f)) {
-                // TOFIX:
-                // check for overpasses (either connecting 2 bridge components or
-                // non-bridge ones) the following statement results in bridges not being
-                // connected if (p.second[i - 1]->data.road->bridge ==
-                // p.second[i]->data.road->bridge) { }
-
-                graph.b_edge(p.second[i - 1]->idx, p.second[i]->idx);
+    // the first point of every location becomes its vertex, the others share it
+    const std::vector<uint32_t> previous = coincident(points);
+
+    // vertex of every point, by its index in the point array of the roads
+    std::vector<int> vertex(roads.coordinates().size());
+    std::vector<int> of(points.size());
+
+    for (size_t i = 0; i < points.size(); i++) {
+        const uint32_t r = origin[i].first, k = origin[i].second;
+        Road *road = roads[r];
+
+        if (previous[i] == i) {
+            of[i] = vlist.size();
+            vlist.push_back(Vertex<Node>(Node(road, &road->coordinates[k]), vlist.size()));
+
+            file.road.push_back(r);
+            file.point.push_back(k);
+        } else {
+            of[i] = of[previous[i]];
+        }
+
+        vertex[road->coordinates.offset() + k] = of[i];
+    }
+
+    std::vector<Link> links;
+    for (size_t r = 0; r < roads.size(); r++) {
+        const Road *road = roads[r];
+        const int *first = vertex.data() + road->coordinates.offset();
+        const size_t count = road->coordinates.size();
+
+        for (size_t k = 1; k < count; k++) {
+            const int u = first[k - 1], v = first[k];
+            if (u == v)
+                continue;
+
+            links.push_back({u, v, (uint32_t)r});
+            if (!road->oneway)
+                links.push_back({v, u, (uint32_t)r});
+        }
+
+        // close roundabouts that aren't closed ways already, in the direction of travel
+        if (road->roundabout && count > 1 && first[count - 1] != first[0])
+            links.push_back({first[count - 1], first[0], (uint32_t)r});
+    }
+
+    if (options.graph == DiGraph<Node>::Driver::Matrix)
+        confirm_matrix(vlist.size());
+
+    DiGraph<Node> graph(vlist, options.graph);
+    for (const Link &link : links)
+        graph.edge(link.from, link.to);
+
+    graph.freeze();
+
+    // where several roads share a segment, the edge keeps the first of them
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    EdgeMap<uint32_t> attribution(graph, NONE);
+
+    for (const Link &link : links) {
+        const int edge = attribution.find(link.from, link.to);
+        if (attribution[edge] == NONE)
+            attribution[edge] = link.road;
+    }
+
+    edge_roads = EdgeRoads(graph, nullptr);
+    file.edge_road.resize(attribution.size());
+
+    for (size_t e = 0; e < attribution.size(); e++) {
+        edge_roads[e] = roads[attribution[e]];
+        file.edge_road[e] = attribution[e];
+    }
+
+    return graph;
+}
+
+DiGraph<Node> construct(const Roads &roads, const cli::Options &options, EdgeRoads &edge_roads, Components<Node> &components) {
+    const std::string filename = stem(options) + "." + driver_name(options.graph) + ".graph.bin";
+    const uint32_t flags = (options.merge ? GraphFile::MERGED : 0) | (options.prune ? GraphFile::PRUNED : 0);
+
+    GraphFile file;
+
+    if (exists(filename)) {
+        Serializable::read(filename.c_str(), file);
+
+        if (file.matches(options.map, roads, flags)) {
+            if (options.graph == DiGraph<Node>::Driver::Matrix)
+                confirm_matrix(file.road.size());
+
+            std::vector<Vertex<Node>> vlist;
+            vlist.reserve(file.road.size());
+
+            for (size_t v = 0; v < file.road.size(); v++) {
+                Road *road = roads[file.road[v]];
+                vlist.push_back(Vertex<Node>(Node(road, &road->coordinates[file.point[v]]), v));
             }
+
+            DiGraph<Node> graph(vlist, options.graph);
+            graph.assign(file.offsets, file.targets);
+
+            if (options.merge) {
+                std::vector<Road *> values;
+                values.reserve(file.edge_road.size());
+
+                for (uint32_t r : file.edge_road)
+                    values.push_back(roads[r]);
+
+                edge_roads = EdgeRoads(file.offsets, file.targets, values);
+            }
+
+            components = Components<Node>(std::move(file.component));
+            return graph;
         }
+
+        std::cout << "'" << filename << "' is stale, rebuilding\n";
     }
 
-    // ----
-    // I'm going to leave this here for future reference
-    // seemed promising, however failed to correctly connect like 5%
-    // of the vertices it should've. still no idea why...
-    //
-    // STEP 2: connect overlapping roads
-    // idea: greedy algorithm to sort the points by distance from origin (or
-    // centroid) points of the same coordinates should be next to each other in
-    // the vector
-    // ----
-
-    // std::sort(vlist.begin(), vlist.end(),
-    //           [origin](const Vertex<Node> &a, const Vertex<Node> &b) {
-    //               return Point::distance_sq(*a.data.loc, origin) <
-    //               Point::distance_sq(*b.data.loc, origin);
-    //           });
-
-    // for (int i = 0; /* i < 100 && */ i < vlist.size() - 1; i++) {
-    //     if (Point::within(*vlist[i].data.loc, *vlist[i + 1].data.loc, 1.f)) {
-    //         // check for overpasses! (either connecting 2 bridge components or
-    //         non-bridge ones) if (vlist[i].data.road->bridge == vlist[i +
-    //         1].data.road->bridge) {
-    //             graph.b_edge(vlist[i].idx, vlist[i + 1].idx);
-    //         }
-    //     }
-    // }
+    file = GraphFile();
+
+    DiGraph<Node> built = options.merge ? construct_merged(roads, options, file, edge_roads) : construct_split(roads, options, file);
+    DiGraph<Node> graph = options.prune ? prune(built, roads, options, file, edge_roads) : std::move(built);
+
+    // save the adjacency, row by row in the order of the driver
+    file.offsets.assign(1, 0);
+    file.targets.clear();
+
+    for (size_t v = 0; v < graph.size(); v++) {
+        for (int to : graph.neighbors(v))
+            file.targets.push_back(to);
+
+        file.offsets.push_back(file.targets.size());
+    }
+
+    components = Components<Node>(graph);
+    file.component = components.labels();
+
+    file.roads = roads.size();
+    file.flags = flags;
+
+    if (cache::stamp(options.map, file.source_size, file.source_mtime))
+        Serializable::write(filename.c_str(), file);
 
     return graph;
 }
 
-DiGraph<Node> construct(const std::vector<Road *> &roads, const cli::Options &options) {
-    std::vector<unsigned int> segments;
-    std::vector<Vertex<Node>> vlist;
+Hierarchy<Node> *hierarchy(const DiGraph<Node> &graph, const Weight<Node> &weight, const cli::Options &options) {
+    const std::string filename = stem(options) + (options.compress ? ".compressed." : ".") + profile(options.routing, options.coeffs) + ".ch.bin";
 
-    for (Road *road : roads) {
-        for (Point *p : road->coordinates)
-            vlist.push_back(Vertex<Node>(Node(road, p), vlist.size()));
+    Hierarchy<Node> *ch = new Hierarchy<Node>;
 
-        if (vlist.size() > 0)
-            segments.push_back(vlist.size());
+    if (exists(filename)) {
+        Serializable::read(filename.c_str(), *ch);
+
+        if (ch->matches(graph, weight, options.map))
+            return ch;
+
+        std::cout << "'" << filename << "' is stale, rebuilding\n";
     }
 
-    return construct_graph(vlist, segments, options);
+    Bench b("Hierarchy construction");
+    ch->build(graph, weight, options.map);
+    b.eval(true);
+
+    Serializable::write(filename.c_str(), *ch);
+    return ch;
+}
+
+EdgeWeights *weights(const DiGraph<Node> &graph, const Weight<Node> *weight, const cli::Options &options) {
+    const std::string filename = stem(options) + "." + profile(options.routing, options.coeffs) + ".weights.bin";
+
+    EdgeWeights *materialized = new EdgeWeights(weight);
+
+    if (exists(filename)) {
+        Serializable::read(filename.c_str(), *materialized);
+
+        if (materialized->bind(graph, options.map))
+            return materialized;
+
+        std::cout << "'" << filename << "' is stale, recomputing\n";
+    }
+
+    Bench b("Edge weight materialization");
+    materialized->build(graph, options.map);
+    b.eval(true);
+
+    std::cout << "materialized " << graph.edge_count() << " edge weights and " << materialized->turns() << " turns\n";
+
+    Serializable::write(filename.c_str(), *materialized);
+    return materialized;
+}
+
+Landmarks<Node> *landmarks(const DiGraph<Node> &graph, const Weight<Node> &weight, const cli::Options &options) {
+    const std::string filename = stem(options) + (options.compress ? ".compressed." : ".") + profile(options.routing, options.coeffs) + ".alt.bin";
+
+    Landmarks<Node> *alt = new Landmarks<Node>;
+
+    if (exists(filename)) {
+        Serializable::read(filename.c_str(), *alt);
+
+        if (alt->matches(graph, weight, options.map, options.landmarks))
+            return alt;
+
+        std::cout << "'" << filename << "' is stale, recomputing\n";
+    }
+
+    Bench b("Landmark precomputation");
+    alt->build(graph, weight, options.map, options.landmarks);
+    b.eval(true);
+
+    Serializable::write(filename.c_str(), *alt);
+    return alt;
 }
 
 }; // namespace loader
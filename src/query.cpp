@@ -0,0 +1,122 @@
+#include "query.h"
+#include "chains.h"
+#include "landmarks.h"
+
+namespace {
+
+/**
+ * @brief Dijkstra specialized for the type of the weight
+ */
+template <typename W> Algorithm<Node> *dijkstra(const cli::Options &options, const DiGraph<Node> &graph, const W &weight) {
+    if (options.heap == HeapType::Dary)
+        return new Dijkstra<Node, DaryHeap<4>, W>(graph, weight);
+
+    if (options.heap == HeapType::Radix)
+        return new Dijkstra<Node, RadixHeap, W>(graph, weight);
+
+    return new Dijkstra<Node, LazyHeap, W>(graph, weight);
+}
+
+template <typename W, typename H> Algorithm<Node> *astar(const cli::Options &options, const DiGraph<Node> &graph, const W &weight, const H &estimate) {
+    if (options.heap == HeapType::Dary)
+        return new AStar<Node, DaryHeap<4>, W, H>(graph, weight, estimate);
+
+    return new AStar<Node, LazyHeap, W, H>(graph, weight, estimate);
+}
+
+/**
+ * @brief A* specialized for the types of the weight and the heuristic
+ */
+template <typename W> Algorithm<Node> *astar(const cli::Options &options, const DiGraph<Node> &graph, const W &weight, const Weight<Node> *estimate) {
+    if (const Landmarks<Node> *alt = dynamic_cast<const Landmarks<Node> *>(estimate))
+        return astar(options, graph, weight, *alt);
+
+    if (const Heuristic *geometric = dynamic_cast<const Heuristic *>(estimate))
+        return astar(options, graph, weight, *geometric);
+
+    return astar(options, graph, weight, *estimate);
+}
+
+/**
+ * @brief Dijkstra or A* specialized for the type of the weight
+ */
+template <typename W> Algorithm<Node> *kernel(const cli::Options &options, const DiGraph<Node> &graph, const W &weight, const Weight<Node> *estimate) {
+    if (options.algorithm == Algorithm<Node>::Driver::Dijkstra)
+        return dijkstra(options, graph, weight);
+
+    return astar(options, graph, weight, estimate);
+}
+
+} // namespace
+
+Algorithm<Node> *algoselect(const cli::Options &options, const DiGraph<Node> &graph, Weight<Node> *weight, const Weight<Node> *estimate, const Hierarchy<Node> *hierarchy) {
+    switch (options.algorithm) {
+    case Algorithm<Node>::Driver::Dijkstra:
+    case Algorithm<Node>::Driver::AStar:
+        // the weights main sets up are known here, their calls are inlined into the search; others go through the vtable
+        if (const EdgeWeights *materialized = dynamic_cast<const EdgeWeights *>(weight))
+            return kernel(options, graph, *materialized, estimate);
+
+        if (const ChainWeight<Node> *chained = dynamic_cast<const ChainWeight<Node> *>(weight))
+            return kernel(options, graph, *chained, estimate);
+
+        return kernel<Weight<Node>>(options, graph, *weight, estimate);
+
+    case Algorithm<Node>::Driver::BFS:
+        return new BFS<Node>(graph);
+
+    case Algorithm<Node>::Driver::DFS:
+        return new DFS<Node>(graph);
+
+    case Algorithm<Node>::Driver::BiDijkstra:
+        return new Bidirectional<Node>(graph, *weight);
+
+    case Algorithm<Node>::Driver::BiAStar:
+        return new Bidirectional<Node>(graph, *weight, estimate);
+
+    case Algorithm<Node>::Driver::CH:
+        if (hierarchy == nullptr)
+            throw std::invalid_argument("Contraction hierarchy is not loaded");
+
+        return new CH<Node>(graph, *hierarchy);
+
+    default:
+        throw std::invalid_argument("Invalid algorithm");
+    }
+}
+
+int snap(const KDTree<Node> &index, const Components<Node> &components, const Point &location) {
+    if (components.count() == 0)
+        return -1;
+
+    const int largest = components.largest();
+    return index.nearest_if(location, [&](int v) { return components.component(v) == largest; });
+}
+
+RouteInfo leg(const DiGraph<Node> &graph, int from, int to, const EdgeRoads *roads) {
+    const Node a = graph.at(from), b = graph.at(to);
+    const Road *first = a.road, *second = b.road;
+
+    const int edge = roads != nullptr ? roads->find(from, to) : -1;
+    if (edge >= 0)
+        first = second = (*roads)[edge];
+
+    RouteInfo info;
+    info.distance = Point::haversine(a, b);
+    info.time = info.distance / (std::max(30.f, (first->maxspeed + second->maxspeed) / 2.f) / 3.6f);
+
+    return info;
+}
+
+RouteInfo measure(const DiGraph<Node> &graph, const std::vector<int> &path, const EdgeRoads *roads) {
+    RouteInfo info;
+
+    for (int i = 1; i < path.size(); i++) {
+        const RouteInfo step = leg(graph, path[i - 1], path[i], roads);
+
+        info.distance += step.distance;
+        info.time += step.time;
+    }
+
+    return info;
+}
@@ -1,8 +1,12 @@
 #include "weights.h"
 #include "algorithm.h"
+#include "cache.h"
 #include "geo.h"
 
 #include <cassert>
+#include <cstdint>
+#include <sstream>
+#include <utility>
 
 const static Coefficients DEFAULT_COEFFS = {
     .slow = 100,
@@ -129,6 +133,124 @@ float Custom::get(const Node &from, const Node &to, const Node *prev) const {
     return total;
 }
 
+uint64_t EdgeWeights::adjacency(const DiGraph<Node> &graph) {
+    // FNV-1a over the rows
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t v = 0; v < graph.size(); v++) {
+        for (int to : graph.neighbors(v))
+            hash = (hash ^ static_cast<uint32_t>(to)) * 0x100000001b3ULL;
+
+        hash = (hash ^ 0xffffffffULL) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+void EdgeWeights::build(const DiGraph<Node> &graph, const std::string &map) {
+    const Transpose incoming(graph);
+
+    cost = EdgeMap<float>(graph);
+    turn_offsets.assign(1, 0);
+    turn_prev.clear();
+    turn_weight.clear();
+
+    for (size_t v = 0, edge = 0; v < graph.size(); v++) {
+        for (int to : graph.neighbors(v)) {
+            const float w = base->get(v, to, -1, graph);
+            cost[edge++] = w;
+
+            for (int prev : incoming.neighbors(v)) {
+                const float turned = base->get(v, to, prev, graph);
+
+                if (turned != w) {
+                    turn_prev.push_back(prev);
+                    turn_weight.push_back(turned);
+                }
+            }
+
+            turn_offsets.push_back(turn_prev.size());
+        }
+    }
+
+    signature = adjacency(graph);
+
+    source_size = 0;
+    source_mtime = 0;
+    cache::stamp(map, source_size, source_mtime);
+}
+
+bool EdgeWeights::bind(const DiGraph<Node> &graph, const std::string &map) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    if (signature == 0 || cost.size() != graph.edge_count())
+        return false;
+
+    if (cache::stamp(map, size, mtime) && (size != source_size || mtime != source_mtime))
+        return false;
+
+    if (signature != adjacency(graph))
+        return false;
+
+    EdgeMap<float> attached(graph);
+    for (size_t e = 0; e < cost.size(); e++)
+        attached[e] = cost[e];
+
+    cost = std::move(attached);
+    return true;
+}
+
+void EdgeWeights::write(std::ostream &os) const {
+    const uint32_t magic = MAGIC, version = VERSION;
+    os.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+    os.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    os.write(reinterpret_cast<const char *>(&signature), sizeof(signature));
+    os.write(reinterpret_cast<const char *>(&source_size), sizeof(source_size));
+    os.write(reinterpret_cast<const char *>(&source_mtime), sizeof(source_mtime));
+
+    std::vector<float> values(cost.size());
+    for (size_t e = 0; e < cost.size(); e++)
+        values[e] = cost[e];
+
+    write_pod(os, values);
+    write_pod(os, turn_offsets);
+    write_pod(os, turn_prev);
+    write_pod(os, turn_weight);
+}
+
+void EdgeWeights::read(std::istream &is) {
+    uint32_t magic = 0, version = 0;
+    is.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    is.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+    signature = 0;
+    if (magic != MAGIC || version != VERSION)
+        return;
+
+    uint64_t stored = 0;
+    is.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+    is.read(reinterpret_cast<char *>(&source_size), sizeof(source_size));
+    is.read(reinterpret_cast<char *>(&source_mtime), sizeof(source_mtime));
+
+    std::vector<float> values;
+    read_pod(is, values);
+    read_pod(is, turn_offsets);
+    read_pod(is, turn_prev);
+    read_pod(is, turn_weight);
+
+    if (!is || turn_offsets.size() != values.size() + 1 || turn_prev.size() != turn_weight.size() || turn_offsets.back() != (int)turn_prev.size())
+        return;
+
+    for (size_t e = 0; e < values.size(); e++)
+        if (turn_offsets[e] > turn_offsets[e + 1])
+            return;
+
+    // the edges themselves come from the graph, see `bind`
+    cost = EdgeMap<float>(std::vector<int>(), std::vector<int>(), values);
+    signature = stored;
+}
+
 /**
  * @brief Create a Weight instance
  * @param type the routing option to use (Fastest, Shortest, or Custom)
@@ -144,3 +266,26 @@ Weight<Node> *create(RouteOpt type, const Coefficients *coeffs) {
         return new Custom(coeffs == nullptr ? DEFAULT_COEFFS : *coeffs);
     }
 }
+
+std::string profile(RouteOpt type, const Coefficients *coeffs) {
+    switch (type) {
+    case RouteOpt::Fastest:
+        return "fastest";
+    case RouteOpt::Shortest:
+        return "shortest";
+    default:
+        break;
+    }
+
+    // FNV-1a over the coefficients
+    const Coefficients &c = coeffs == nullptr ? DEFAULT_COEFFS : *coeffs;
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&c);
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(Coefficients); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    std::ostringstream ss;
+    ss << "custom-" << std::hex << hash;
+    return ss.str();
+}